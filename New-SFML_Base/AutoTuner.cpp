@@ -0,0 +1,223 @@
+#include "AutoTuner.h"
+#include "Capabilities.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_tune_clock;
+
+// Mixed escape times and interior, so neither extreme dominates.
+const char* const TUNE_SCENE = "seahorse";
+
+// Small enough that the whole calibration takes seconds.
+const int TUNE_SIZE = 512;
+
+// Timed frames per candidate, after one to warm up.
+const int TUNE_FRAMES = 3;
+
+
+AutoTuner::AutoTuner()
+	: scene(*FindScene(TUNE_SCENE)),
+	imageWidth(TUNE_SIZE),
+	imageHeight(TUNE_SIZE)
+{
+}
+
+bool AutoTuner::selectScene(const std::string& name)
+{
+	const BenchScene* found = FindScene(name);
+	if (!found) {
+		cout << "Unknown scene " << name << endl;
+		return false;
+	}
+
+	scene = *found;
+	return true;
+}
+
+double AutoTuner::TimeConfig(Backend backend, const TuneConfig& config)
+{
+	Mandelbrot::setTuning(config);
+
+	Mandelbrot mandel(imageWidth, imageHeight);
+	mandel.setBackend(backend);
+	mandel.setMaxIterations((float)scene.iterations);
+
+	mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+
+	std::vector<double> times;
+	for (int i = 0; i < TUNE_FRAMES; ++i) {
+		the_tune_clock::time_point start = the_tune_clock::now();
+		mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+		duration<double, std::milli> taken = the_tune_clock::now() - start;
+
+		times.push_back(taken.count());
+	}
+	std::sort(times.begin(), times.end());
+
+	return times[times.size() / 2];
+}
+
+void AutoTuner::TuneSetting(Backend backend, const char* name, int TuneConfig::*setting,
+	const std::vector<int>& candidates, TuneConfig& best)
+{
+	double bestTime = 0.0;
+	int bestValue = best.*setting;
+
+	for (int value : candidates) {
+		TuneConfig trial = best;
+		trial.*setting = value;
+
+		double time = TimeConfig(backend, trial);
+		cout << "       " << std::left << std::setw(16) << name << std::right << std::setw(4) << value
+			<< " = " << std::fixed << std::setprecision(3) << time << " ms" << endl;
+
+		if (bestTime == 0.0 || time < bestTime) {
+			bestTime = time;
+			bestValue = value;
+		}
+	}
+
+	best.*setting = bestValue;
+}
+
+TuneConfig AutoTuner::Run()
+{
+	const Capabilities& caps = Capabilities::Get();
+	const CpuInfo& cpu = caps.getCpu();
+
+	cout << "Tuning on " << scene.name << " at " << imageWidth << "x" << imageHeight << endl;
+
+	// Settings are tuned one at a time, each keeping the best so far.
+	TuneConfig best;
+
+	bool ampValid = false;
+	for (const BackendCandidate& candidate : caps.getBackends()) {
+		if (candidate.backend == Backend::AMP) { ampValid = candidate.valid; }
+	}
+	if (ampValid) {
+		TuneSetting(Backend::AMP, "amp tile size", &TuneConfig::ampTileSize, { 8, 16, 32 }, best);
+	}
+
+	// Lanes up to twice the vector width, to cover some latency hiding.
+	std::vector<int> lanes = { 1 };
+	for (int width : { 4, 8, 16 }) {
+		if (width <= std::max(4, caps.getSimdWidth() * 2)) { lanes.push_back(width); }
+	}
+	TuneSetting(Backend::CPU, "simd lanes", &TuneConfig::simdLanes, lanes, best);
+
+	// Powers of two, plus one thread per core and one per logical processor.
+	std::set<int> threads = { cpu.physicalCores, cpu.logicalProcessors };
+	for (int count = 1; count < cpu.logicalProcessors; count *= 2) {
+		threads.insert(count);
+	}
+	TuneSetting(Backend::CPU, "cpu threads", &TuneConfig::cpuThreads, std::vector<int>(threads.begin(), threads.end()), best);
+
+	TuneSetting(Backend::CPU, "cpu strip rows", &TuneConfig::cpuStripRows, { 1, 2, 4, 8, 16 }, best);
+
+	Mandelbrot::setTuning(best);
+
+	cout << "Best: amp tile " << best.ampTileSize << ", " << best.simdLanes << " lanes, "
+		<< best.cpuThreads << " threads, " << best.cpuStripRows << " rows per strip" << endl;
+	return best;
+}
+
+std::string AutoTuner::MachineName()
+{
+	std::string host = "unknown";
+
+#if defined(_WIN32)
+	char name[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD length = sizeof(name);
+	if (GetComputerNameA(name, &length)) { host = name; }
+#else
+	char name[256] = {};
+	if (gethostname(name, sizeof(name) - 1) == 0 && name[0]) { host = name; }
+#endif
+
+	// Keep it safe for use in a filename.
+	for (char& c : host) {
+		if (!std::isalnum((unsigned char)c) && c != '-' && c != '.') { c = '_'; }
+	}
+	return host;
+}
+
+std::string AutoTuner::DefaultPath()
+{
+	return "tune_" + MachineName() + ".cfg";
+}
+
+bool AutoTuner::Save(const std::string& filename, const TuneConfig& config)
+{
+	std::ofstream outfile(filename);
+
+	outfile << "# Render settings tuned for this machine; regenerate with --tune\n"
+		<< "machine=" << MachineName() << "/" << std::thread::hardware_concurrency() << "\n"
+		<< "amp_tile_size=" << config.ampTileSize << "\n"
+		<< "cpu_threads=" << config.cpuThreads << "\n"
+		<< "cpu_strip_rows=" << config.cpuStripRows << "\n"
+		<< "simd_lanes=" << config.simdLanes << "\n";
+
+	outfile.close();
+	if (!outfile) {
+		cout << "Error writing to " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+bool AutoTuner::Load(const std::string& filename, TuneConfig& config)
+{
+	std::ifstream infile(filename);
+	if (!infile) { return false; }
+
+	std::ostringstream machine;
+	machine << MachineName() << "/" << std::thread::hardware_concurrency();
+
+	TuneConfig loaded;
+	std::string line;
+	while (std::getline(infile, line)) {
+		if (line.empty() || line[0] == '#') { continue; }
+
+		size_t equals = line.find('=');
+		if (equals == std::string::npos) { continue; }
+
+		std::string key = line.substr(0, equals);
+		std::string value = line.substr(equals + 1);
+
+		if (key == "machine" && value != machine.str()) {
+			cout << "Ignoring " << filename << ", which was tuned on " << value << endl;
+			return false;
+		}
+		if (key == "amp_tile_size") { loaded.ampTileSize = std::atoi(value.c_str()); }
+		if (key == "cpu_threads") { loaded.cpuThreads = std::atoi(value.c_str()); }
+		if (key == "cpu_strip_rows") { loaded.cpuStripRows = std::atoi(value.c_str()); }
+		if (key == "simd_lanes") { loaded.simdLanes = std::atoi(value.c_str()); }
+	}
+
+	// Anything the kernels don't have an instance for falls back to the default.
+	TuneConfig defaults;
+	if (loaded.ampTileSize != 8 && loaded.ampTileSize != 16 && loaded.ampTileSize != 32) { loaded.ampTileSize = defaults.ampTileSize; }
+	if (loaded.simdLanes != 1 && loaded.simdLanes != 4 && loaded.simdLanes != 8 && loaded.simdLanes != 16) { loaded.simdLanes = defaults.simdLanes; }
+	if (loaded.cpuThreads < 0) { loaded.cpuThreads = defaults.cpuThreads; }
+	if (loaded.cpuStripRows < 1) { loaded.cpuStripRows = defaults.cpuStripRows; }
+
+	config = loaded;
+	return true;
+}
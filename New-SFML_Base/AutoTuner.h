@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Mandelbrot.h"
+#include "SceneSuite.h"
+
+#include <string>
+#include <vector>
+
+
+// Calibrates TuneConfig on a representative scene, and keeps the result
+// in a per-machine file so later runs start with this machine's optimum.
+class AutoTuner
+{
+private:
+	BenchScene scene;
+	int imageWidth, imageHeight;
+
+	// Median frame time, in milliseconds, of one configuration.
+	double TimeConfig(Backend backend, const TuneConfig& config);
+
+	// Time every value of one setting on top of best, keep the fastest.
+	void TuneSetting(Backend backend, const char* name, int TuneConfig::*setting,
+		const std::vector<int>& candidates, TuneConfig& best);
+
+public:
+	AutoTuner();
+
+	// Tune against a different standard scene.
+	bool selectScene(const std::string& name);
+
+	// Run the calibration, printing each candidate's time, and
+	// return the best configuration found.
+	TuneConfig Run();
+
+	// Identifies this machine, so a file copied from elsewhere is ignored.
+	static std::string MachineName();
+
+	// tune_<machine>.cfg in the working directory.
+	static std::string DefaultPath();
+
+	static bool Load(const std::string& filename, TuneConfig& config);
+	static bool Save(const std::string& filename, const TuneConfig& config);
+};
@@ -0,0 +1,227 @@
+#include "BatchRender.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_batch_clock;
+
+
+BatchRender::BatchRender()
+	: lanes(0), collectStats(false), antialias(0)
+{
+}
+
+bool BatchRender::ParseJob(const std::string& line, BatchJob& job)
+{
+	std::istringstream fields(line);
+	std::string iterations;
+
+	fields >> job.centreX >> job.centreY >> job.viewWidth >> iterations
+		>> job.imageWidth >> job.imageHeight >> job.output;
+
+	job.iterations = iterations == "auto" ? AUTO_ITERATIONS : std::atoi(iterations.c_str());
+
+	// Every field must be present and sensible.
+	return !fields.fail() && job.viewWidth > 0.0 && (job.iterations > 0 || iterations == "auto")
+		&& job.imageWidth > 0 && job.imageHeight > 0;
+}
+
+bool BatchRender::LoadJobs(const char* filename)
+{
+	std::ifstream infile(filename);
+	if (!infile) {
+		cout << "Unable to open job list " << filename << endl;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(infile, line)) {
+		++lineNumber;
+
+		// Skip blank lines and comments.
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') { continue; }
+
+		BatchJob job;
+		if (!ParseJob(line, job)) {
+			cout << filename << ":" << lineNumber << ": malformed job, expected "
+				<< "'centreX centreY width iterations imageWidth imageHeight output'" << endl;
+			return false;
+		}
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+int BatchRender::ChooseLanes() const
+{
+	int available = std::max(1, (int)std::thread::hardware_concurrency());
+
+	if (lanes > 0) { return std::min(lanes, (int)jobs.size()); }
+
+	// Large jobs saturate the accelerator by themselves, so
+	// running them side by side only adds contention.
+	long long totalPixels = 0;
+	for (const BatchJob& job : jobs) {
+		totalPixels += (long long)job.imageWidth * job.imageHeight;
+	}
+	if (totalPixels / (long long)jobs.size() >= SATURATING_PIXELS) { return 1; }
+
+	return std::min(available, (int)jobs.size());
+}
+
+// Name of the cost heatmap written alongside an output image.
+std::string HeatmapName(const std::string& output)
+{
+	std::string base = output;
+	if (base.size() > 4 && base.compare(base.size() - 4, 4, ".tga") == 0) {
+		base.erase(base.size() - 4);
+	}
+	return base + "_cost.tga";
+}
+
+bool BatchRender::RenderJob(const BatchJob& job, RenderStats& stats, int& supersampled, int& iterations, double& renderSeconds, std::string& error)
+{
+	// Each job owns its image, so jobs may render concurrently.
+	Mandelbrot mandel(job.imageWidth, job.imageHeight);
+
+	// Batches run without a display; a failed kernel fails the job
+	// instead of waiting on a dialog.
+	mandel.setErrorDialogs(false);
+
+	if (job.iterations == AUTO_ITERATIONS) {
+		mandel.ChooseIterationsView(job.centreX, job.centreY, job.viewWidth);
+	}
+	else {
+		mandel.setMaxIterations((float)job.iterations);
+	}
+	iterations = mandel.getMaxIterations();
+
+	// Only the render itself, which does the iterations stats count.
+	the_batch_clock::time_point renderStart = the_batch_clock::now();
+	mandel.ComputeView(job.centreX, job.centreY, job.viewWidth);
+	renderSeconds = duration<double>(the_batch_clock::now() - renderStart).count();
+
+	supersampled = mandel.Antialias(antialias);
+
+	// Nothing is written for a frame the kernel failed to compute.
+	if (!mandel.getKernelError().empty()) {
+		error = mandel.getKernelError();
+		return false;
+	}
+
+	if (!mandel.WriteTga(job.output.c_str())) { return false; }
+
+	if (collectStats) {
+		stats = mandel.ComputeStats();
+		return mandel.WriteCostHeatmap(HeatmapName(job.output).c_str());
+	}
+	return true;
+}
+
+int BatchRender::Run()
+{
+	if (jobs.empty()) {
+		cout << "No jobs to render." << endl;
+		return 0;
+	}
+
+	const int laneCount = ChooseLanes();
+
+	// Workers claim the next unrendered job until none remain.
+	std::atomic<int> nextJob(0);
+	std::atomic<int> failures(0);
+	std::mutex reportLock;
+	RenderStats totals;
+
+	the_batch_clock::time_point start = the_batch_clock::now();
+
+	auto worker = [&]() {
+		for (int i = nextJob++; i < (int)jobs.size(); i = nextJob++) {
+			the_batch_clock::time_point jobStart = the_batch_clock::now();
+			RenderStats stats;
+			int supersampled = 0;
+			int iterations = 0;
+			double renderSeconds = 0.0;
+			std::string error;
+			bool rendered = RenderJob(jobs[i], stats, supersampled, iterations, renderSeconds, error);
+			duration<double> jobTime = the_batch_clock::now() - jobStart;
+
+			if (!rendered) { ++failures; }
+
+			std::lock_guard<std::mutex> lock(reportLock);
+			cout << (rendered ? "Rendered " : "FAILED ") << jobs[i].output << " ("
+				<< jobs[i].imageWidth << "x" << jobs[i].imageHeight << ") in "
+				<< std::fixed << std::setprecision(3) << jobTime.count() << " s";
+
+			if (jobs[i].iterations == AUTO_ITERATIONS) {
+				cout << ", " << iterations << " iterations (auto)";
+			}
+
+			if (antialias >= 2 && rendered) {
+				long long pixels = (long long)jobs[i].imageWidth * jobs[i].imageHeight;
+				cout << ", " << std::setprecision(1) << 100.0 * supersampled / pixels << "% supersampled";
+			}
+
+			if (collectStats && rendered) {
+				long long pixels = (long long)jobs[i].imageWidth * jobs[i].imageHeight;
+				cout << ", " << std::setprecision(2) << stats.iterations / renderSeconds / 1.0e9 << " Giter/s, "
+					<< std::setprecision(1) << 100.0 * stats.escaped / pixels << "% escaped, "
+					<< 100.0 * stats.shortcut / pixels << "% shortcut, "
+					<< 100.0 * stats.mirrored / pixels << "% mirrored";
+				totals.Add(stats);
+			}
+
+			if (!error.empty()) {
+				cout << ": " << error;
+			}
+			cout << endl;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < laneCount; ++i) {
+		workers.emplace_back(worker);
+	}
+	worker();
+
+	for (std::thread& t : workers) {
+		t.join();
+	}
+
+	duration<double> wallTime = the_batch_clock::now() - start;
+
+	long long totalPixels = 0;
+	for (const BatchJob& job : jobs) {
+		totalPixels += (long long)job.imageWidth * job.imageHeight;
+	}
+
+	// Throughput summary.
+	cout << endl << "Jobs:        " << jobs.size() << " (" << failures << " failed)"
+		<< endl << "Concurrency: " << laneCount
+		<< endl << "Pixels:      " << totalPixels
+		<< endl << "Wall time:   " << std::setprecision(3) << wallTime.count() << " s"
+		<< endl << "Throughput:  " << std::setprecision(2) << totalPixels / wallTime.count() / 1.0e6 << " Mpixel/s, "
+		<< jobs.size() / wallTime.count() << " jobs/s" << endl;
+
+	if (collectStats) {
+		cout << "Iterations:  " << totals.iterations << " ("
+			<< totals.iterations / wallTime.count() / 1.0e9 << " Giter/s), "
+			<< totals.escaped << " escaped, " << totals.interior << " interior, "
+			<< totals.shortcut << " shortcut, " << totals.mirrored << " mirrored" << endl;
+	}
+
+	return failures;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Mandelbrot.h"
+
+#include <string>
+#include <vector>
+
+// Jobs at or above this many pixels keep the accelerator busy on
+// their own, so are rendered one at a time by default.
+const int SATURATING_PIXELS = 2048 * 2048;
+
+
+// Iteration limit of a job whose list gives "auto"; the limit is then
+// chosen for the view by Mandelbrot::ChooseIterations.
+const int AUTO_ITERATIONS = 0;
+
+
+// A single viewport to render, as read from a job list.
+struct BatchJob
+{
+	// Centre and width of the view on the complex plane.
+	double centreX, centreY;
+	double viewWidth;
+
+	// Iteration limit, or AUTO_ITERATIONS.
+	int iterations;
+
+	// Output resolution and destination.
+	int imageWidth, imageHeight;
+	std::string output;
+};
+
+
+class BatchRender
+{
+private:
+	std::vector<BatchJob> jobs;
+
+	// Number of jobs rendered concurrently; zero picks automatically.
+	int lanes;
+
+	// Count each job's iterations and write its cost heatmap.
+	bool collectStats;
+
+	// Anti-aliasing sample grid for edge pixels; below 2 is off.
+	int antialias;
+
+	bool ParseJob(const std::string& line, BatchJob& job);
+	int ChooseLanes() const;
+	bool RenderJob(const BatchJob& job, RenderStats& stats, int& supersampled, int& iterations, double& renderSeconds, std::string& error);
+
+public:
+	BatchRender();
+
+	// Read viewports from a job list file, one per line:
+	// centreX centreY width iterations imageWidth imageHeight output.tga
+	// where iterations may be "auto". Blank lines and lines beginning
+	// with '#' are ignored.
+	bool LoadJobs(const char* filename);
+
+	void setLanes(int concurrentJobs) { lanes = concurrentJobs; };
+	void setCollectStats(bool collect) { collectStats = collect; };
+	void setAntialias(int grid) { antialias = grid; };
+	const std::vector<BatchJob>& getJobs() { return jobs; };
+
+	// Render every loaded job without a window and print throughput.
+	// With stats collection on, each job's output.tga is joined by an
+	// output_cost.tga heatmap and iteration counters are reported.
+	// With anti-aliasing on, edge pixels are supersampled before writing.
+	// Returns the number of jobs which failed.
+	int Run();
+};
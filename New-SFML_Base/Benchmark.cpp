@@ -0,0 +1,337 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_bench_clock;
+
+// Defaults replacing the old SAMPLE_SIZE loop.
+const int DEFAULT_WARMUP = 5;
+const int DEFAULT_REPETITIONS = 50;
+
+
+Benchmark::Benchmark()
+	: warmup(DEFAULT_WARMUP),
+	repetitions(DEFAULT_REPETITIONS),
+	imageWidth(WIDTH),
+	imageHeight(HEIGHT),
+	backends({ Backend::AMP, Backend::CPU }),
+	precisions({ Mandelbrot::getDefaultPrecision() })
+{
+	scenes = StandardScenes();
+}
+
+bool Benchmark::selectScene(const std::string& name)
+{
+	const BenchScene* scene = FindScene(name);
+	if (!scene) {
+		cout << "Unknown scene " << name << endl;
+		return false;
+	}
+
+	scenes.assign(1, *scene);
+	return true;
+}
+
+bool Benchmark::selectPrecisions(const std::string& list)
+{
+	if (list == "all") {
+		precisions = { Precision::FLOAT, Precision::DOUBLE, Precision::DOUBLE_DOUBLE, Precision::FIXED64, Precision::FIXED128 };
+		return true;
+	}
+
+	std::vector<Precision> chosen;
+	std::istringstream names(list);
+	std::string name;
+	while (std::getline(names, name, ',')) {
+		Precision precision;
+		if (!Mandelbrot::ParsePrecision(name, precision)) {
+			cout << "Unknown precision " << name << endl;
+			return false;
+		}
+		chosen.push_back(precision);
+	}
+
+	if (chosen.empty()) { return false; }
+	precisions = chosen;
+	return true;
+}
+
+std::string Benchmark::BaselineKey(const std::string& backend, const std::string& precision, const std::string& formula,
+	const std::string& scene, int width, int height)
+{
+	return backend + "/" + precision + "/" + formula + "/" + scene + "/" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+bool Benchmark::Measure(Backend backend, Precision precision, const BenchScene& scene, BenchResult& result)
+{
+	Mandelbrot mandel(imageWidth, imageHeight);
+	mandel.setBackend(backend);
+	mandel.setPrecision(precision);
+	mandel.setMaxIterations((float)scene.iterations);
+
+	// Benchmarks run without a window; a failed kernel is reported by Run.
+	mandel.setErrorDialogs(false);
+
+	// Untimed frames let caches, pools and the accelerator settle.
+	for (int i = 0; i < warmup; ++i) {
+		mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+		if (!mandel.getKernelError().empty()) { return false; }
+	}
+
+	std::vector<double> times;
+	PerfSample counters;
+	for (int i = 0; i < repetitions; ++i) {
+		perf.Start();
+		the_bench_clock::time_point start = the_bench_clock::now();
+		mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+		duration<double, std::milli> taken = the_bench_clock::now() - start;
+		counters.Add(perf.Stop());
+
+		// A failed frame's time measures nothing worth recording.
+		if (!mandel.getKernelError().empty()) { return false; }
+
+		times.push_back(taken.count());
+	}
+	counters.Divide(repetitions);
+	std::sort(times.begin(), times.end());
+
+	// Every repetition renders the same view, so the last frame's
+	// counts give the work done per frame.
+	long long iterations = mandel.ComputeStats().iterations;
+
+	result.backend = Mandelbrot::BackendName(backend);
+	result.precision = Mandelbrot::PrecisionName(precision);
+	result.formula = Mandelbrot::FormulaName(mandel.getFormula());
+	result.scene = scene.name;
+	result.imageWidth = imageWidth;
+	result.imageHeight = imageHeight;
+	result.repetitions = repetitions;
+
+	double total = 0.0;
+	for (double t : times) { total += t; }
+	result.mean = total / times.size();
+
+	double squares = 0.0;
+	for (double t : times) { squares += (t - result.mean) * (t - result.mean); }
+	result.stddev = times.size() > 1 ? std::sqrt(squares / (times.size() - 1)) : 0.0;
+
+	// Nearest-rank percentiles.
+	result.median = times[times.size() / 2];
+	result.p95 = times[std::min(times.size() - 1, (times.size() * 95 + 99) / 100 - 1)];
+	result.fastest = times.front();
+
+	result.iterations = iterations;
+	result.mpixelsPerSecond = (double)imageWidth * imageHeight / (result.median / 1000.0) / 1.0e6;
+	result.giterationsPerSecond = (double)iterations / (result.median / 1000.0) / 1.0e9;
+	result.counters = counters;
+
+	return true;
+}
+
+// Print a frame's hardware events, scaled to millions per frame.
+void PrintCounters(const PerfSample& counters)
+{
+	cout << "      ";
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		PerfEvent event = (PerfEvent)i;
+		if (counters.has(event)) {
+			cout << ' ' << PerfCounters::EventName(event) << ' ' << std::setprecision(2) << counters.get(event) / 1.0e6 << "M";
+		}
+	}
+	if (counters.Ipc() > 0.0) {
+		cout << " ipc " << std::setprecision(2) << counters.Ipc();
+	}
+	cout << endl;
+}
+
+void Benchmark::Run()
+{
+	results.clear();
+
+	if (!perf.IsAvailable()) {
+		cout << "Hardware counters unavailable; reporting wall time only." << endl;
+	}
+
+	for (Backend backend : backends) {
+		for (Precision precision : precisions) {
+			for (const BenchScene& scene : scenes) {
+				BenchResult result;
+				if (!Measure(backend, precision, scene, result)) {
+					cout << std::left << std::setw(5) << Mandelbrot::BackendName(backend)
+						<< std::setw(14) << Mandelbrot::PrecisionName(precision)
+						<< std::setw(16) << scene.name << std::right << " skipped, kernel failed" << endl;
+					continue;
+				}
+				results.push_back(result);
+
+				cout << std::left << std::setw(5) << result.backend << std::setw(14) << result.precision
+					<< std::setw(16) << result.scene << std::right
+					<< std::fixed << std::setprecision(3)
+					<< " median " << result.median << " ms, mean " << result.mean
+					<< " ms, p95 " << result.p95 << " ms, stddev " << result.stddev
+					<< " ms, " << std::setprecision(1) << result.mpixelsPerSecond << " Mpixel/s, "
+					<< std::setprecision(3) << result.giterationsPerSecond << " Giter/s" << endl;
+
+				if (perf.IsAvailable()) { PrintCounters(result.counters); }
+			}
+		}
+	}
+}
+
+void Benchmark::WriteCsv(std::ostream& out)
+{
+	out << "backend,precision,formula,scene,width,height,repetitions,median_ms,mean_ms,p95_ms,stddev_ms,min_ms,mpixels_per_s,giters_per_s";
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		out << ',' << PerfCounters::EventName((PerfEvent)i);
+	}
+	out << ",ipc\n";
+
+	out << std::fixed << std::setprecision(4);
+	for (const BenchResult& r : results) {
+		out << r.backend << ',' << r.precision << ',' << r.formula << ',' << r.scene << ',' << r.imageWidth << ',' << r.imageHeight << ','
+			<< r.repetitions << ',' << r.median << ',' << r.mean << ',' << r.p95 << ','
+			<< r.stddev << ',' << r.fastest << ',' << r.mpixelsPerSecond << ',' << r.giterationsPerSecond;
+
+		// Uncounted events are left empty.
+		for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+			out << ',';
+			if (r.counters.has((PerfEvent)e)) { out << r.counters.get((PerfEvent)e); }
+		}
+		out << ',';
+		if (r.counters.Ipc() > 0.0) { out << r.counters.Ipc(); }
+		out << '\n';
+	}
+}
+
+void Benchmark::WriteJson(std::ostream& out)
+{
+	out << "{\n  \"suite_version\": " << SCENE_SUITE_VERSION << ",\n  \"warmup\": " << warmup << ",\n  \"results\": [";
+
+	out << std::fixed << std::setprecision(4);
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchResult& r = results[i];
+
+		out << (i ? "," : "") << "\n    { \"backend\": \"" << r.backend << "\", \"precision\": \"" << r.precision
+			<< "\", \"formula\": \"" << r.formula << "\", \"scene\": \"" << r.scene
+			<< "\", \"width\": " << r.imageWidth << ", \"height\": " << r.imageHeight
+			<< ", \"repetitions\": " << r.repetitions
+			<< ", \"median_ms\": " << r.median << ", \"mean_ms\": " << r.mean
+			<< ", \"p95_ms\": " << r.p95 << ", \"stddev_ms\": " << r.stddev
+			<< ", \"min_ms\": " << r.fastest << ", \"mpixels_per_s\": " << r.mpixelsPerSecond
+			<< ", \"giters_per_s\": " << r.giterationsPerSecond;
+
+		// Uncounted events are null.
+		for (int e = 0; e < PERF_EVENT_COUNT; ++e) {
+			out << ", \"" << PerfCounters::EventName((PerfEvent)e) << "\": ";
+			if (r.counters.has((PerfEvent)e)) { out << r.counters.get((PerfEvent)e); }
+			else { out << "null"; }
+		}
+		out << ", \"ipc\": ";
+		if (r.counters.Ipc() > 0.0) { out << r.counters.Ipc(); }
+		else { out << "null"; }
+		out << " }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+bool Benchmark::LoadBaseline(const char* filename)
+{
+	std::ifstream infile(filename);
+	if (!infile) {
+		cout << "Unable to open baseline " << filename << endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(infile, line)) {
+		if (line.empty() || line[0] == '#') { continue; }
+
+		// version,backend,scene,mpixels_per_s,giters_per_s[,precision[,width,height[,formula]]]
+		std::istringstream fields(line);
+		std::string version, backend, scene, mpixels, giters, precision, width, height, formula;
+		std::getline(fields, version, ',');
+		std::getline(fields, backend, ',');
+		std::getline(fields, scene, ',');
+		std::getline(fields, mpixels, ',');
+		std::getline(fields, giters, ',');
+		// Lines without a precision predate the other precisions, whatever
+		// the default is now.
+		if (!std::getline(fields, precision, ',') || precision.empty()) {
+			precision = Mandelbrot::PrecisionName(Precision::FLOAT);
+		}
+		std::getline(fields, width, ',');
+		std::getline(fields, height, ',');
+		if (!std::getline(fields, formula, ',') || formula.empty()) {
+			formula = Mandelbrot::FormulaName(Formula::MANDELBROT);
+		}
+
+		if (std::atoi(version.c_str()) != SCENE_SUITE_VERSION) {
+			cout << "Baseline " << filename << " was recorded against suite version "
+				<< version << ", not " << SCENE_SUITE_VERSION << endl;
+			return false;
+		}
+
+		// Times at one resolution say nothing about another.
+		if (width.empty() || height.empty()) {
+			cout << "Baseline line for " << backend << " " << scene << " has no resolution; skipped" << endl;
+			continue;
+		}
+
+		baseline[BaselineKey(backend, precision, formula, scene, std::atoi(width.c_str()), std::atoi(height.c_str()))] = { std::atof(mpixels.c_str()), std::atof(giters.c_str()) };
+	}
+	return true;
+}
+
+bool Benchmark::WriteBaseline(const char* filename)
+{
+	std::ofstream outfile(filename);
+
+	outfile << "# version,backend,scene,mpixels_per_s,giters_per_s,precision,width,height,formula\n" << std::fixed << std::setprecision(4);
+	for (const BenchResult& r : results) {
+		outfile << SCENE_SUITE_VERSION << ',' << r.backend << ',' << r.scene << ','
+			<< r.mpixelsPerSecond << ',' << r.giterationsPerSecond << ',' << r.precision << ','
+			<< r.imageWidth << ',' << r.imageHeight << ',' << r.formula << '\n';
+	}
+
+	if (!outfile) {
+		cout << "Error writing to " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+int Benchmark::CompareBaseline(double thresholdPercent)
+{
+	int regressions = 0;
+
+	for (const BenchResult& r : results) {
+		auto expected = baseline.find(BaselineKey(r.backend, r.precision, r.formula, r.scene, r.imageWidth, r.imageHeight));
+		if (expected == baseline.end()) {
+			cout << "No baseline for " << BaselineKey(r.backend, r.precision, r.formula, r.scene, r.imageWidth, r.imageHeight) << endl;
+			continue;
+		}
+
+		// Slowdown relative to the baseline, in percent; negative is faster.
+		double pixelLoss = 100.0 * (1.0 - r.mpixelsPerSecond / expected->second.first);
+		double iterationLoss = expected->second.second > 0.0
+			? 100.0 * (1.0 - r.giterationsPerSecond / expected->second.second) : 0.0;
+
+		bool regressed = pixelLoss > thresholdPercent || iterationLoss > thresholdPercent;
+		if (regressed) { ++regressions; }
+
+		cout << (regressed ? "REGRESSION " : "ok         ") << std::left << std::setw(5) << r.backend
+			<< std::setw(14) << r.precision << std::setw(16) << r.scene << std::right << std::fixed << std::setprecision(1)
+			<< r.mpixelsPerSecond << " Mpixel/s vs " << expected->second.first << " ("
+			<< std::showpos << -pixelLoss << std::noshowpos << "%), "
+			<< std::setprecision(3) << r.giterationsPerSecond << " Giter/s vs " << expected->second.second << endl;
+	}
+	return regressions;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Mandelbrot.h"
+#include "PerfCounters.h"
+#include "SceneSuite.h"
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Default slowdown, in percent, reported as a regression.
+const double DEFAULT_REGRESSION_THRESHOLD = 10.0;
+
+// Timing summary of one backend rendering one scene at one precision,
+// in milliseconds.
+struct BenchResult
+{
+	std::string backend;
+	std::string precision;
+	std::string formula;
+	std::string scene;
+	int imageWidth, imageHeight;
+	int repetitions;
+
+	double median, mean, p95, stddev, fastest;
+
+	// Throughput of the median frame.
+	long long iterations;
+	double mpixelsPerSecond;
+	double giterationsPerSecond;
+
+	// Mean hardware events per timed frame, where counted.
+	PerfSample counters;
+};
+
+
+// Times ComputeMandelbrot on each backend, precision and scene, away
+// from the interactive window, and reports the distribution of frame times.
+class Benchmark
+{
+private:
+	int warmup;
+	int repetitions;
+	int imageWidth, imageHeight;
+
+	std::vector<Backend> backends;
+	std::vector<Precision> precisions;
+	std::vector<BenchScene> scenes;
+	std::vector<BenchResult> results;
+
+	// Opened before any render, so worker threads inherit them.
+	PerfCounters perf;
+
+	// Expected Mpixel/s and Giter/s, keyed by backend, precision,
+	// formula, scene then resolution.
+	std::map<std::string, std::pair<double, double>> baseline;
+
+	static std::string BaselineKey(const std::string& backend, const std::string& precision, const std::string& formula,
+		const std::string& scene, int width, int height);
+
+	// Time one backend, precision and scene; false if its kernel failed.
+	bool Measure(Backend backend, Precision precision, const BenchScene& scene, BenchResult& result);
+
+public:
+	Benchmark();
+
+	void setWarmup(int frames) { warmup = frames; };
+	void setRepetitions(int frames) { repetitions = frames; };
+	void setResolution(int width, int height) { imageWidth = width; imageHeight = height; };
+	void setBackends(const std::vector<Backend>& use) { backends = use; };
+
+	// Restrict the run to a single standard scene.
+	bool selectScene(const std::string& name);
+
+	// Time each of a comma-separated list of precisions, or "all" of
+	// them, rather than only the default precision.
+	bool selectPrecisions(const std::string& list);
+
+	// Time every scene on every backend and precision, printing progress to the console.
+	void Run();
+
+	const std::vector<BenchResult>& getResults() { return results; };
+
+	// Machine-readable output.
+	void WriteCsv(std::ostream& out);
+	void WriteJson(std::ostream& out);
+
+	// Baseline files hold one "version,backend,scene,mpixels_per_s,giters_per_s,precision,width,height,formula"
+	// line per result, recorded on the machine being tested. Lines
+	// without a precision were recorded in float, and those without a
+	// formula are of the Mandelbrot set.
+	bool LoadBaseline(const char* filename);
+	bool WriteBaseline(const char* filename);
+
+	// Print any result slower than the baseline by more than threshold
+	// percent, and return how many there were.
+	int CompareBaseline(double thresholdPercent);
+};
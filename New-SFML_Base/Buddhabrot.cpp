@@ -0,0 +1,327 @@
+#include "Buddhabrot.h"
+#include "Formula.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_buddha_clock;
+
+
+Buddhabrot::Buddhabrot(int width, int height)
+	: imageWidth(width),
+	imageHeight(height),
+	centreX(-0.5),
+	centreY(0.0),
+	viewWidth(3.0),
+	formula(Formula::MANDELBROT),
+	nebula(false),
+	maxSamples(16 * BUDDHA_ROUND_SAMPLES),
+	tolerance(BUDDHA_DEFAULT_TOLERANCE),
+	sampleLeft(-2.0),
+	sampleBottom(-2.0),
+	sampleWidth(4.0),
+	sampleHeight(4.0),
+	samplesTaken(0),
+	orbitsKept(0)
+{
+}
+
+void Buddhabrot::BuildImportance()
+{
+	TraceSpan span("buddhabrot prepass", "render");
+
+	const int size = BUDDHA_PREPASS_SIZE;
+	const unsigned int limit = NEBULA_LIMITS[0];
+
+	Mandelbrot prepass(size, size);
+	prepass.setFormula(formula);
+	prepass.setMaxIterations((float)limit);
+	prepass.ComputeMandelbrot(sampleLeft, sampleLeft + sampleWidth, sampleBottom + sampleHeight, sampleBottom);
+
+	const ImageBuffer& counts = prepass.GetIterations();
+
+	// Cells on either side of the boundary hold the long orbits, which
+	// are rare and make up the structure of the image.
+	cellCumulative.resize(size * size);
+	double total = 0.0;
+
+	for (int y = 0; y < size; ++y) {
+		for (int x = 0; x < size; ++x) {
+			const bool inside = counts[y * size + x] >= limit;
+			bool boundary = false;
+
+			for (int dy = -1; dy <= 1; ++dy) {
+				for (int dx = -1; dx <= 1; ++dx) {
+					const int nx = x + dx, ny = y + dy;
+					if (nx < 0 || ny < 0 || nx >= size || ny >= size) { continue; }
+
+					boundary = boundary || (counts[ny * size + nx] >= limit) != inside;
+				}
+			}
+
+			total += boundary ? BUDDHA_BOUNDARY_WEIGHT
+				: inside ? BUDDHA_INTERIOR_WEIGHT : BUDDHA_EXTERIOR_WEIGHT;
+			cellCumulative[y * size + x] = total;
+		}
+	}
+}
+
+// Iterate the orbit of one sample. If it escapes, add weight to every
+// pixel it visits, in each channel whose limit it escaped within.
+// Returns whether the orbit was kept.
+template <typename F>
+bool TraceOrbit(double cx, double cy, double weight, const int* limits, int channels,
+	double left, double bottom, double scaleX, double scaleY, int width, int height, float* histogram)
+{
+	if (F::KnownInterior(cx, cy)) { return false; }
+
+	const OwnComplex<double> point(cx, cy);
+	OwnComplex<double> z, c;
+
+	// First find whether, and when, the orbit escapes, storing nothing.
+	F::Start(point, OwnComplex<double>(), z, c);
+
+	const int limit = limits[0];
+	int escape = 0;
+	while (z.SquaredMagnitude() < 4.0 && escape < limit) {
+		F::Step(z, c);
+		++escape;
+	}
+	if (escape >= limit) { return false; }
+
+	// Then walk it again, plotting each point.
+	F::Start(point, OwnComplex<double>(), z, c);
+
+	for (int i = 0; i < escape; ++i) {
+		F::Step(z, c);
+
+		const int px = (int)std::floor((z.GetX() - left) * scaleX);
+		const int py = (int)std::floor((z.GetY() - bottom) * scaleY);
+		if (px < 0 || py < 0 || px >= width || py >= height) { continue; }
+
+		for (int channel = 0; channel < channels; ++channel) {
+			if (escape < limits[channel]) {
+				histogram[(channel * height + py) * width + px] += (float)weight;
+			}
+		}
+	}
+	return true;
+}
+
+template <typename F>
+long long Buddhabrot::SampleRound(long long samples)
+{
+	WorkerPool& pool = WorkerPool::Shared();
+
+	const int width = imageWidth;
+	const int height = imageHeight;
+	const int channels = getChannels();
+	const int cells = (int)cellCumulative.size();
+	const int size = BUDDHA_PREPASS_SIZE;
+	const double total = cellCumulative.back();
+
+	// The view the density is drawn over.
+	const double viewHeight = viewWidth * height / width;
+	const double left = centreX - viewWidth / 2;
+	const double bottom = centreY - viewHeight / 2;
+	const double scaleX = width / viewWidth;
+	const double scaleY = height / viewHeight;
+
+	// A plain Buddhabrot is the first channel alone.
+	const int* limits = NEBULA_LIMITS;
+
+	// Samples are handed out in chunks, so fast workers take more.
+	const long long chunk = 4096;
+	std::atomic<long long> next(0);
+	std::atomic<long long> kept(0);
+
+	pool.Run([&](int worker) {
+		TraceSpan span("buddhabrot samples", "render", worker);
+
+		// Each worker's histogram is allocated, and so first touched, by that worker.
+		std::vector<float>& histogram = workerDensity[worker];
+		if (histogram.empty()) { histogram.assign((size_t)channels * width * height, 0.0f); }
+
+		std::mt19937_64& random = workerRandom[worker];
+		std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+		long long mine = 0;
+
+		for (long long first = next.fetch_add(chunk); first < samples; first = next.fetch_add(chunk)) {
+			for (long long i = first; i < std::min(first + chunk, samples); ++i) {
+				// Pick a cell by its weight, then a point uniformly within it.
+				const int cell = std::min(cells - 1, (int)(std::upper_bound(cellCumulative.begin(), cellCumulative.end(),
+					unit(random) * total) - cellCumulative.begin()));
+				const double cellWeight = cellCumulative[cell] - (cell > 0 ? cellCumulative[cell - 1] : 0.0);
+
+				const double cx = sampleLeft + (cell % size + unit(random)) * sampleWidth / size;
+				const double cy = sampleBottom + (cell / size + unit(random)) * sampleHeight / size;
+
+				// Weighting by the inverse of the cell's over-sampling keeps
+				// the density that of uniform sampling.
+				const double weight = total / (cells * cellWeight);
+
+				mine += TraceOrbit<F>(cx, cy, weight, limits, channels,
+					left, bottom, scaleX, scaleY, width, height, histogram.data());
+			}
+		}
+
+		kept += mine;
+	});
+
+	return kept;
+}
+
+void Buddhabrot::Merge()
+{
+	TraceSpan span("buddhabrot merge", "render");
+
+	const size_t length = density.size();
+	const int workers = (int)workerDensity.size();
+
+	// Workers sum disjoint slices, so the merge needs no locks either.
+	const size_t slice = 1 << 16;
+	std::atomic<size_t> next(0);
+
+	WorkerPool::Shared().Run([&](int worker) {
+		for (size_t first = next.fetch_add(slice); first < length; first = next.fetch_add(slice)) {
+			const size_t last = std::min(first + slice, length);
+
+			for (int w = 0; w < workers; ++w) {
+				std::vector<float>& histogram = workerDensity[w];
+				if (histogram.empty()) { continue; }
+
+				for (size_t i = first; i < last; ++i) {
+					density[i] += histogram[i];
+					histogram[i] = 0.0f;
+				}
+			}
+		}
+	});
+}
+
+void Buddhabrot::Run()
+{
+	if (formula == Formula::JULIA) {
+		cout << "Julia sets have no Buddhabrot; using mandelbrot" << endl;
+		formula = Formula::MANDELBROT;
+	}
+
+	BuildImportance();
+
+	const int workers = WorkerPool::Shared().getWorkerCount();
+	workerDensity.assign(workers, std::vector<float>());
+	workerRandom.clear();
+	for (int w = 0; w < workers; ++w) {
+		workerRandom.emplace_back(0x9E3779B97F4A7C15ULL * (w + 1));
+	}
+
+	density.assign((size_t)getChannels() * imageWidth * imageHeight, 0.0);
+	std::vector<double> previous(density.size(), 0.0);
+	double previousTotal = 0.0;
+
+	samplesTaken = 0;
+	orbitsKept = 0;
+
+	cout << (nebula ? "Nebulabrot " : "Buddhabrot ") << imageWidth << "x" << imageHeight
+		<< ", " << Mandelbrot::FormulaName(formula) << ", up to " << maxSamples << " samples on "
+		<< workers << " workers" << endl;
+
+	the_buddha_clock::time_point start = the_buddha_clock::now();
+
+	for (int round = 1; samplesTaken < maxSamples; ++round) {
+		const long long samples = std::min(BUDDHA_ROUND_SAMPLES, maxSamples - samplesTaken);
+
+		the_buddha_clock::time_point roundStart = the_buddha_clock::now();
+		long long kept;
+		switch (formula) {
+		case Formula::MULTIBROT3: kept = SampleRound<MultibrotStep<3>>(samples); break;
+		case Formula::MULTIBROT4: kept = SampleRound<MultibrotStep<4>>(samples); break;
+		case Formula::BURNING_SHIP: kept = SampleRound<BurningShipStep>(samples); break;
+		default: kept = SampleRound<MandelbrotStep>(samples); break;
+		}
+		Merge();
+		duration<double> roundTime = the_buddha_clock::now() - roundStart;
+
+		samplesTaken += samples;
+		orbitsKept += kept;
+
+		// Convergence is how far this round moved the normalised density.
+		double total = 0.0;
+		for (double value : density) { total += value; }
+
+		cout << "Round " << round << ": " << samplesTaken << " samples, "
+			<< std::fixed << std::setprecision(2) << samples / roundTime.count() / 1.0e6 << " Msamples/s, "
+			<< std::setprecision(1) << 100.0 * kept / samples << "% kept, ";
+
+		// Until an orbit lands in view there is no density to normalise,
+		// and nothing to converge on.
+		if (total <= 0.0) {
+			cout << "no density yet" << endl;
+			continue;
+		}
+
+		double change = 0.0;
+		for (size_t i = 0; i < density.size(); ++i) {
+			change += std::abs(density[i] / total - (previousTotal > 0.0 ? previous[i] / previousTotal : 0.0));
+		}
+		const bool comparable = previousTotal > 0.0;
+		previous = density;
+		previousTotal = total;
+
+		cout << "change " << std::setprecision(4) << change << endl;
+
+		if (comparable && change < tolerance) {
+			cout << "Converged below " << tolerance << endl;
+			break;
+		}
+	}
+
+	duration<double> totalTime = the_buddha_clock::now() - start;
+	cout << "Samples:     " << samplesTaken << " (" << orbitsKept << " orbits kept)"
+		<< endl << "Time:        " << std::setprecision(3) << totalTime.count() << " s"
+		<< endl << "Throughput:  " << std::setprecision(2) << samplesTaken / totalTime.count() / 1.0e6 << " Msamples/s" << endl;
+}
+
+bool Buddhabrot::WriteTga(const char* filename)
+{
+	const int pixels = imageWidth * imageHeight;
+	const int channels = getChannels();
+
+	// Each channel is scaled so its brightest 0.1% of lit pixels are
+	// white, then brightened by a square root, as density falls off fast.
+	std::vector<double> white(channels, 1.0);
+	for (int channel = 0; channel < channels; ++channel) {
+		std::vector<double> lit;
+		for (int i = 0; i < pixels; ++i) {
+			if (density[channel * pixels + i] > 0.0) { lit.push_back(density[channel * pixels + i]); }
+		}
+		if (lit.empty()) { continue; }
+
+		std::nth_element(lit.begin(), lit.begin() + lit.size() * 999 / 1000, lit.end());
+		white[channel] = lit[lit.size() * 999 / 1000];
+	}
+
+	std::vector<uint32_t> colours(pixels);
+	for (int i = 0; i < pixels; ++i) {
+		uint32_t colour = 0;
+		for (int k = 0; k < 3; ++k) {
+			const int channel = nebula ? k : 0;
+			const double t = std::min(1.0, density[channel * pixels + i] / white[channel]);
+			colour = (colour << 8) | (uint32_t)(255.0 * std::sqrt(t));
+		}
+		colours[i] = colour;
+	}
+
+	return Mandelbrot::WriteTga(filename, colours.data(), imageWidth, imageHeight);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Mandelbrot.h"
+
+#include <random>
+#include <vector>
+
+// Side of the coarse render which steers sampling toward the boundary.
+const int BUDDHA_PREPASS_SIZE = 256;
+
+// Relative chance of sampling a pre-pass cell on the boundary, an
+// ordinary escaping cell, and a cell deep inside the set. Interior
+// cells are still sampled now and then, so the estimate stays unbiased.
+const double BUDDHA_BOUNDARY_WEIGHT = 16.0;
+const double BUDDHA_EXTERIOR_WEIGHT = 1.0;
+const double BUDDHA_INTERIOR_WEIGHT = 0.05;
+
+// Samples taken between convergence checks.
+const long long BUDDHA_ROUND_SAMPLES = 1 << 22;
+
+// Stop once a round changes the normalised density by less than this
+// (L1 distance between successive estimates).
+const double BUDDHA_DEFAULT_TOLERANCE = 0.005;
+
+// Iteration limits of the red, green and blue channels of a
+// Nebulabrot. A plain Buddhabrot uses the first for a single channel.
+const int NEBULA_LIMITS[3] = { 5000, 500, 50 };
+
+
+// Renders the density of escaping orbits (the Buddhabrot), or three
+// such densities at different iteration limits as the channels of a
+// Nebulabrot. Orbits are iterated on the worker pool by the formula
+// policies of the escape-time kernels. Each worker accumulates into its
+// own histogram, and histograms are merged between rounds, so no worker
+// ever contends with another.
+class Buddhabrot
+{
+private:
+	int imageWidth, imageHeight;
+
+	// View the density is drawn over, on the complex plane.
+	double centreX, centreY, viewWidth;
+
+	Formula formula;
+	bool nebula;
+	long long maxSamples;
+	double tolerance;
+
+	// Region c is sampled from, and the pre-pass cells' cumulative
+	// sampling weights over it.
+	double sampleLeft, sampleBottom, sampleWidth, sampleHeight;
+	std::vector<double> cellCumulative;
+
+	// One histogram of density per worker, channel-major, and their sum.
+	std::vector<std::vector<float>> workerDensity;
+	std::vector<std::mt19937_64> workerRandom;
+	std::vector<double> density;
+
+	long long samplesTaken, orbitsKept;
+
+	int getChannels() const { return nebula ? 3 : 1; };
+
+	// Coarse render of the sampling region, weighting its cells.
+	void BuildImportance();
+
+	// Take samples across the pool, into the workers' histograms.
+	template <typename F> long long SampleRound(long long samples);
+
+	// Add the workers' histograms into density, emptying them.
+	void Merge();
+
+public:
+	Buddhabrot(int width, int height);
+
+	void setView(double x, double y, double width) { centreX = x; centreY = y; viewWidth = width; };
+	void setFormula(Formula use) { formula = use; };
+	void setNebula(bool use) { nebula = use; };
+	void setMaxSamples(long long samples) { maxSamples = samples; };
+	void setTolerance(double change) { tolerance = change; };
+
+	// Sample in rounds until the density converges or maxSamples is
+	// reached, printing each round's sampling rate and convergence.
+	void Run();
+
+	// Tone-map the density and write it as a TGA.
+	bool WriteTga(const char* filename);
+};
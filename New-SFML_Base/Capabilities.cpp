@@ -0,0 +1,400 @@
+#include "Capabilities.h"
+#include "SceneSuite.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <set>
+
+#if defined(_WIN32)
+#include <intrin.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <sstream>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(_WIN32)
+#include <cpuid.h>
+#endif
+
+// Need to access the concurrency libraries.
+using namespace concurrency;
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_probe_clock;
+
+// Backends are probed on a small render of the first standard scene.
+const int PROBE_SIZE = 256;
+
+
+Capabilities::Capabilities()
+{
+	DetectCpu();
+	DetectAccelerators();
+	RankBackends();
+}
+
+const Capabilities& Capabilities::Get()
+{
+	static const Capabilities capabilities;
+	return capabilities;
+}
+
+const char* Capabilities::SimdName(SimdLevel level)
+{
+	switch (level) {
+	case SimdLevel::SSE2: return "SSE2";
+	case SimdLevel::SSE4_1: return "SSE4.1";
+	case SimdLevel::AVX: return "AVX";
+	case SimdLevel::AVX2: return "AVX2";
+	case SimdLevel::AVX512: return "AVX-512";
+	case SimdLevel::NEON: return "NEON";
+	default: return "scalar";
+	}
+}
+
+int Capabilities::getSimdWidth() const
+{
+	switch (cpu.simd) {
+	case SimdLevel::SSE2: case SimdLevel::SSE4_1: case SimdLevel::NEON: return 4;
+	case SimdLevel::AVX: case SimdLevel::AVX2: return 8;
+	case SimdLevel::AVX512: return 16;
+	default: return 1;
+	}
+}
+
+Backend Capabilities::getChosen() const
+{
+	for (const BackendCandidate& candidate : backends) {
+		if (candidate.valid) { return candidate.backend; }
+	}
+
+	// The CPU backend always works.
+	return Backend::CPU;
+}
+
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+// Registers a, b, c, d of the given cpuid leaf and subleaf.
+void CpuId(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#if defined(_WIN32)
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Which register states the OS saves on context switch.
+unsigned long long EnabledStates()
+{
+#if defined(_WIN32)
+	return _xgetbv(0);
+#else
+	unsigned lo, hi;
+	__asm__ volatile ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+
+void DetectSimd(CpuInfo& cpu)
+{
+	unsigned regs[4];
+	CpuId(0, 0, regs);
+	const unsigned maxLeaf = regs[0];
+
+	CpuId(1, 0, regs);
+	const bool sse2 = (regs[3] >> 26) & 1;
+	const bool sse41 = (regs[2] >> 19) & 1;
+	const bool osxsave = (regs[2] >> 27) & 1;
+	const bool avx = ((regs[2] >> 28) & 1) && osxsave && (EnabledStates() & 0x6) == 0x6;
+	cpu.fma = avx && ((regs[2] >> 12) & 1);
+
+	bool avx2 = false, avx512 = false;
+	if (maxLeaf >= 7) {
+		CpuId(7, 0, regs);
+		avx2 = avx && ((regs[1] >> 5) & 1);
+		avx512 = avx && ((regs[1] >> 16) & 1) && (EnabledStates() & 0xE6) == 0xE6;
+	}
+
+	cpu.simd = avx512 ? SimdLevel::AVX512 : avx2 ? SimdLevel::AVX2 : avx ? SimdLevel::AVX
+		: sse41 ? SimdLevel::SSE4_1 : sse2 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+
+	// Brand string, if the CPU has one.
+	CpuId(0x80000000, 0, regs);
+	if (regs[0] >= 0x80000004) {
+		char brand[49] = {};
+		for (unsigned leaf = 0; leaf < 3; ++leaf) {
+			CpuId(0x80000002 + leaf, 0, (unsigned*)(brand + leaf * 16));
+		}
+		cpu.brand = brand;
+		cpu.brand.erase(0, cpu.brand.find_first_not_of(' '));
+	}
+}
+
+#else
+
+void DetectSimd(CpuInfo& cpu)
+{
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+	cpu.simd = SimdLevel::NEON;
+#endif
+}
+
+#endif
+
+
+#if defined(_WIN32)
+
+void DetectCores(CpuInfo& cpu)
+{
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationAll, NULL, &length);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) { return; }
+
+	std::vector<char> buffer(length);
+	auto info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data();
+	if (!GetLogicalProcessorInformationEx(RelationAll, info, &length)) { return; }
+
+	// Records are variable length; step through by their size.
+	for (DWORD offset = 0; offset < length; ) {
+		auto record = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+
+		if (record->Relationship == RelationProcessorCore) {
+			++cpu.physicalCores;
+		}
+		else if (record->Relationship == RelationCache && record->Cache.Type != CacheInstruction) {
+			int kb = (int)(record->Cache.CacheSize / 1024);
+			if (record->Cache.Level == 1) { cpu.l1dKB = kb; }
+			if (record->Cache.Level == 2) { cpu.l2KB = kb; }
+			if (record->Cache.Level == 3) { cpu.l3KB = kb; }
+		}
+
+		offset += record->Size;
+	}
+}
+
+#elif defined(__linux__)
+
+int ReadSizeKB(const std::string& path)
+{
+	// Sizes read like "32K" or "8192K".
+	std::ifstream file(path);
+	int size = 0;
+	char unit = 'K';
+	if (!(file >> size)) { return 0; }
+	file >> unit;
+
+	return unit == 'M' ? size * 1024 : size;
+}
+
+void DetectCores(CpuInfo& cpu)
+{
+	// A core is a distinct (package, core) pair.
+	std::set<std::pair<int, int>> cores;
+	for (int id = 0; ; ++id) {
+		std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+		std::ifstream package(topology + "physical_package_id"), core(topology + "core_id");
+		if (!package || !core) { break; }
+
+		int packageId = 0, coreId = 0;
+		package >> packageId;
+		core >> coreId;
+		cores.insert({ packageId, coreId });
+	}
+	cpu.physicalCores = (int)cores.size();
+
+	for (int index = 0; ; ++index) {
+		std::string cache = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+		std::ifstream levelFile(cache + "level"), typeFile(cache + "type");
+		if (!levelFile || !typeFile) { break; }
+
+		int level = 0;
+		std::string type;
+		levelFile >> level;
+		typeFile >> type;
+		if (type == "Instruction") { continue; }
+
+		int kb = ReadSizeKB(cache + "size");
+		if (level == 1) { cpu.l1dKB = kb; }
+		if (level == 2) { cpu.l2KB = kb; }
+		if (level == 3) { cpu.l3KB = kb; }
+	}
+}
+
+#else
+
+void DetectCores(CpuInfo& cpu)
+{
+}
+
+#endif
+
+
+void Capabilities::DetectCpu()
+{
+	const CpuTopology& topology = WorkerPool::SharedTopology();
+
+	cpu.physicalCores = 0;
+	cpu.logicalProcessors = topology.getProcessorCount();
+	cpu.numaNodes = (int)topology.getNodes().size();
+	cpu.l1dKB = cpu.l2KB = cpu.l3KB = 0;
+	cpu.simd = SimdLevel::SCALAR;
+	cpu.fma = false;
+
+	DetectSimd(cpu);
+	DetectCores(cpu);
+
+	// Unknown core count: assume no SMT.
+	if (cpu.physicalCores == 0) { cpu.physicalCores = cpu.logicalProcessors; }
+}
+
+void Capabilities::DetectAccelerators()
+{
+	const accelerator defaultAccelerator = accelerator(accelerator::default_accelerator);
+
+	for (const accelerator& a : accelerator::get_all()) {
+		AcceleratorInfo info;
+		info.description = a.description;
+		info.devicePath = a.device_path;
+		info.dedicatedMemoryMB = float(a.dedicated_memory) / 1024.0f;
+		info.isDefault = a.device_path == defaultAccelerator.device_path;
+		info.hasDisplay = a.has_display;
+		info.isDebug = a.is_debug;
+		info.isEmulated = a.is_emulated;
+		info.doublePrecision = a.supports_double_precision;
+		info.limitedDoublePrecision = a.supports_limited_double_precision;
+
+		accelerators.push_back(info);
+	}
+}
+
+// Time one frame of the probe scene, after a frame to warm up, or zero on failure.
+double ProbeBackend(Backend backend)
+{
+	const BenchScene& scene = StandardScenes().front();
+
+	Mandelbrot mandel(PROBE_SIZE, PROBE_SIZE);
+	mandel.setBackend(backend);
+	mandel.setMaxIterations((float)scene.iterations);
+
+	// Probing runs before any window, so a failure must not wait on a dialog.
+	mandel.setErrorDialogs(false);
+
+	try {
+		mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+		if (!mandel.getKernelError().empty()) { return 0.0; }
+
+		the_probe_clock::time_point start = the_probe_clock::now();
+		mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+		duration<double, std::milli> taken = the_probe_clock::now() - start;
+
+		if (!mandel.getKernelError().empty()) { return 0.0; }
+		return taken.count();
+	}
+	catch (const std::exception&) {
+		return 0.0;
+	}
+}
+
+void Capabilities::RankBackends()
+{
+	backends = {
+		{ Backend::AMP, "amp", true, "", 0.0 },
+		{ Backend::CPU, "cpu", true, "", 0.0 },
+	};
+
+	// AMP renders on the default accelerator, which must be able to run
+	// kernels at all, and at a useful speed.
+	const AcceleratorInfo* defaultAccelerator = nullptr;
+	for (const AcceleratorInfo& a : accelerators) {
+		if (a.isDefault) { defaultAccelerator = &a; }
+	}
+
+	BackendCandidate& amp = backends[0];
+	if (!defaultAccelerator) {
+		amp.valid = false;
+		amp.note = "no accelerator";
+	}
+	else if (defaultAccelerator->devicePath == accelerator::cpu_accelerator) {
+		amp.valid = false;
+		amp.note = "default accelerator cannot run kernels";
+	}
+	else if (defaultAccelerator->devicePath == accelerator::direct3d_ref) {
+		amp.valid = false;
+		amp.note = "default accelerator is the reference rasteriser";
+	}
+	else if (defaultAccelerator->isEmulated) {
+		amp.note = "emulated accelerator";
+	}
+
+	for (BackendCandidate& candidate : backends) {
+		if (!candidate.valid) { continue; }
+
+		candidate.probeMs = ProbeBackend(candidate.backend);
+		if (candidate.probeMs <= 0.0) {
+			candidate.valid = false;
+			candidate.note = "probe render failed";
+		}
+	}
+
+	// Fastest valid first; invalid backends keep their order at the end.
+	std::stable_sort(backends.begin(), backends.end(), [](const BackendCandidate& a, const BackendCandidate& b) {
+		if (a.valid != b.valid) { return a.valid; }
+		return a.valid && a.probeMs < b.probeMs;
+	});
+}
+
+void Capabilities::Report() const
+{
+	const std::wstring bs[2] = { L"false", L"true" };
+
+	cout << "CPU: " << (cpu.brand.empty() ? "unknown" : cpu.brand)
+		<< endl << "       cores / logical processors        = " << cpu.physicalCores << " / " << cpu.logicalProcessors
+		<< (cpu.logicalProcessors > cpu.physicalCores ? " (SMT)" : "")
+		<< endl << "       NUMA nodes                        = " << cpu.numaNodes
+		<< endl << "       L1d / L2 / L3                     = " << cpu.l1dKB << " / " << cpu.l2KB << " / " << cpu.l3KB << " KB"
+		<< endl << "       SIMD                              = " << SimdName(cpu.simd) << (cpu.fma ? " + FMA" : "")
+		<< ", " << getSimdWidth() << " float lanes" << endl;
+
+	WorkerPool::SharedTopology().Report();
+
+	if (accelerators.empty()) {
+		cout << "No accelerators found that are compatible with C++ AMP" << endl;
+	}
+	else {
+		cout << "Accelerators found that are compatible with C++ AMP" << endl;
+	}
+	for (const AcceleratorInfo& a : accelerators) {
+		std::wcout << ": " << a.description << (a.isDefault ? L" (default)" : L"")
+			<< endl << "       device_path                       = " << a.devicePath
+			<< endl << "       dedicated_memory                  = " << std::setprecision(4) << a.dedicatedMemoryMB << " Mb"
+			<< endl << "       has_display                       = " << bs[a.hasDisplay]
+			<< endl << "       is_debug                          = " << bs[a.isDebug]
+			<< endl << "       is_emulated                       = " << bs[a.isEmulated]
+			<< endl << "       supports_double_precision         = " << bs[a.doublePrecision]
+			<< endl << "       supports_limited_double_precision = " << bs[a.limitedDoublePrecision]
+			<< endl;
+	}
+
+	cout << "Backends, fastest first (" << PROBE_SIZE << "x" << PROBE_SIZE << " probe frame):" << endl;
+	for (const BackendCandidate& candidate : backends) {
+		cout << "       " << std::left << std::setw(35) << candidate.name << std::right << "= ";
+		if (candidate.valid) {
+			cout << std::fixed << std::setprecision(3) << candidate.probeMs << " ms";
+		}
+		else {
+			cout << "unavailable";
+		}
+		if (!candidate.note.empty()) { cout << " (" << candidate.note << ")"; }
+		cout << endl;
+	}
+	cout << " chosen backend = " << Mandelbrot::BackendName(getChosen()) << endl;
+}
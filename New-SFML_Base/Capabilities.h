@@ -0,0 +1,91 @@
+#pragma once
+
+// (Falconer, R(2021) [2]) \\
+
+#include "Mandelbrot.h"
+
+#include <string>
+#include <vector>
+
+
+// Widest SIMD instruction set the CPU and OS both support, in order.
+enum class SimdLevel { SCALAR, SSE2, SSE4_1, AVX, AVX2, AVX512, NEON };
+
+// What the machine offers the CPU backend.
+struct CpuInfo
+{
+	std::string brand;
+
+	int physicalCores;
+	int logicalProcessors;
+	int numaNodes;
+
+	// Per-core (L1 data, L2) and shared (L3) sizes in KB; zero if unknown.
+	int l1dKB, l2KB, l3KB;
+
+	SimdLevel simd;
+	bool fma;
+};
+
+// A C++ AMP accelerator, as reported by the runtime.
+struct AcceleratorInfo
+{
+	std::wstring description;
+	std::wstring devicePath;
+	float dedicatedMemoryMB;
+
+	bool isDefault;
+	bool hasDisplay, isDebug, isEmulated;
+	bool doublePrecision, limitedDoublePrecision;
+};
+
+// A render backend, whether it can run here, and how fast it was.
+struct BackendCandidate
+{
+	Backend backend;
+	const char* name;
+
+	bool valid;
+	std::string note;
+
+	// Time to render the probe frame; zero if not probed.
+	double probeMs;
+};
+
+
+// Detects what the machine can do, ranks the render backends and
+// picks the fastest one that works. Replaces the old AMPQuery report.
+class Capabilities
+{
+private:
+	CpuInfo cpu;
+	std::vector<AcceleratorInfo> accelerators;
+
+	// Every registered backend, fastest valid first.
+	std::vector<BackendCandidate> backends;
+
+	void DetectCpu();
+	void DetectAccelerators();
+	void RankBackends();
+
+	Capabilities();
+
+public:
+	// Detection and probing happen once, on first use.
+	static const Capabilities& Get();
+
+	const CpuInfo& getCpu() const { return cpu; };
+	const std::vector<AcceleratorInfo>& getAccelerators() const { return accelerators; };
+	const std::vector<BackendCandidate>& getBackends() const { return backends; };
+
+	// The fastest valid backend.
+	Backend getChosen() const;
+
+	// Floats per vector register at the detected SIMD level.
+	int getSimdWidth() const;
+
+	// Write the full capability report and ranking to the console.
+	void Report() const;
+
+	static const char* SimdName(SimdLevel level);
+};
@@ -0,0 +1,152 @@
+#include "CpuTopology.h"
+
+#include <iostream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#endif
+
+// Import things we need from the standard library
+using std::cout;
+using std::endl;
+
+
+CpuTopology::CpuTopology()
+{
+	if (!DetectNodes() || nodes.empty()) {
+		// Unknown layout: treat the machine as a single node.
+		nodes.clear();
+		nodes.push_back({ 0, {} });
+
+		unsigned count = std::thread::hardware_concurrency();
+		for (unsigned i = 0; i < (count > 0 ? count : 1); ++i) {
+			nodes[0].processors.push_back(i);
+		}
+	}
+}
+
+#if defined(_WIN32)
+
+bool CpuTopology::DetectNodes()
+{
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationNumaNode, NULL, &length);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) { return false; }
+
+	std::vector<char> buffer(length);
+	auto info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data();
+	if (!GetLogicalProcessorInformationEx(RelationNumaNode, info, &length)) { return false; }
+
+	// Records are variable length; step through by their size.
+	for (DWORD offset = 0; offset < length; ) {
+		auto record = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+
+		NumaNode node = { (int)record->NumaNode.NodeNumber, {} };
+		const GROUP_AFFINITY& mask = record->NumaNode.GroupMask;
+
+		for (int bit = 0; bit < 64; ++bit) {
+			if (mask.Mask & ((KAFFINITY)1 << bit)) {
+				node.processors.push_back(mask.Group * 64 + bit);
+			}
+		}
+		nodes.push_back(node);
+
+		offset += record->Size;
+	}
+	return true;
+}
+
+bool CpuTopology::PinCurrentThread(int processor)
+{
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = (WORD)(processor / 64);
+	affinity.Mask = (KAFFINITY)1 << (processor % 64);
+
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL) != 0;
+}
+
+#elif defined(__linux__)
+
+bool CpuTopology::DetectNodes()
+{
+	// Each node directory lists its processors as ranges, e.g. "0-7,16-23".
+	for (int id = 0; ; ++id) {
+		std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+		if (!cpulist) { break; }
+
+		NumaNode node = { id, {} };
+		std::string range;
+
+		while (std::getline(cpulist, range, ',')) {
+			int first = 0, last = 0;
+			char dash = 0;
+
+			std::istringstream parse(range);
+			parse >> first;
+			last = (parse >> dash >> last) ? last : first;
+
+			for (int cpu = first; cpu <= last; ++cpu) {
+				node.processors.push_back(cpu);
+			}
+		}
+
+		// Memory-only nodes have no processors to schedule on.
+		if (!node.processors.empty()) { nodes.push_back(node); }
+	}
+	return !nodes.empty();
+}
+
+bool CpuTopology::PinCurrentThread(int processor)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#else
+
+bool CpuTopology::DetectNodes()
+{
+	return false;
+}
+
+bool CpuTopology::PinCurrentThread(int processor)
+{
+	return false;
+}
+
+#endif
+
+int CpuTopology::getProcessorCount() const
+{
+	int count = 0;
+	for (const NumaNode& node : nodes) {
+		count += (int)node.processors.size();
+	}
+	return count;
+}
+
+void CpuTopology::Report() const
+{
+	cout << "CPU topology: " << getProcessorCount() << " logical processors in "
+		<< nodes.size() << " NUMA node" << (nodes.size() == 1 ? "" : "s") << endl;
+
+	for (const NumaNode& node : nodes) {
+		cout << "       node " << node.id << "                            = "
+			<< node.processors.size() << " processors (";
+
+		for (size_t i = 0; i < node.processors.size(); ++i) {
+			cout << (i ? " " : "") << node.processors[i];
+		}
+		cout << ")" << endl;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+
+// Describes which logical processors belong to which NUMA node, and
+// pins threads to them.
+class CpuTopology
+{
+public:
+	struct NumaNode
+	{
+		int id;
+
+		// Logical processor numbers, counted across processor groups.
+		std::vector<int> processors;
+	};
+
+private:
+	std::vector<NumaNode> nodes;
+
+	bool DetectNodes();
+
+public:
+	// Detect the topology of the machine we are running on.
+	CpuTopology();
+
+	const std::vector<NumaNode>& getNodes() const { return nodes; };
+	int getProcessorCount() const;
+
+	// Restrict the calling thread to a single logical processor.
+	static bool PinCurrentThread(int processor);
+
+	// Write the topology to the console.
+	void Report() const;
+};
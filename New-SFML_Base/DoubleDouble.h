@@ -0,0 +1,89 @@
+#pragma once
+
+
+// An unevaluated sum hi + lo of two doubles, carrying about 106 bits of
+// mantissa. Built only from error-free transformations of plain double
+// addition and multiplication, so it also runs in restrict(amp) code on
+// accelerators with full double precision. It relies on strict IEEE
+// evaluation: build with /fp:precise, never /fp:fast or FMA contraction.
+struct DoubleDouble
+{
+	double hi, lo;
+
+	DoubleDouble() restrict(cpu, amp)
+		: hi(0.0), lo(0.0) {}
+	DoubleDouble(double value) restrict(cpu, amp)
+		: hi(value), lo(0.0) {}
+	DoubleDouble(double high, double low) restrict(cpu, amp)
+		: hi(high), lo(low) {}
+};
+
+
+// a + b exactly, as a rounded sum and its error.
+inline DoubleDouble TwoSum(double a, double b) restrict(cpu, amp)
+{
+	double s = a + b;
+	double bb = s - a;
+	return DoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+// As TwoSum, given |a| >= |b|.
+inline DoubleDouble QuickTwoSum(double a, double b) restrict(cpu, amp)
+{
+	double s = a + b;
+	return DoubleDouble(s, b - (s - a));
+}
+
+// a * b exactly, by Dekker's splitting into 26-bit halves.
+inline DoubleDouble TwoProduct(double a, double b) restrict(cpu, amp)
+{
+	const double SPLITTER = 134217729.0; // 2^27 + 1
+
+	double p = a * b;
+
+	double ta = SPLITTER * a;
+	double aHigh = ta - (ta - a);
+	double aLow = a - aHigh;
+
+	double tb = SPLITTER * b;
+	double bHigh = tb - (tb - b);
+	double bLow = b - bHigh;
+
+	return DoubleDouble(p, ((aHigh * bHigh - p) + aHigh * bLow + aLow * bHigh) + aLow * bLow);
+}
+
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) restrict(cpu, amp)
+{
+	DoubleDouble s = TwoSum(a.hi, b.hi);
+	DoubleDouble t = TwoSum(a.lo, b.lo);
+
+	s = QuickTwoSum(s.hi, s.lo + t.hi);
+	return QuickTwoSum(s.hi, s.lo + t.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a) restrict(cpu, amp)
+{
+	return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) restrict(cpu, amp)
+{
+	return a + (-b);
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) restrict(cpu, amp)
+{
+	DoubleDouble p = TwoProduct(a.hi, b.hi);
+	return QuickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+inline bool operator<(const DoubleDouble& a, const DoubleDouble& b) restrict(cpu, amp)
+{
+	return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline bool operator<=(const DoubleDouble& a, const DoubleDouble& b) restrict(cpu, amp)
+{
+	return !(b < a);
+}
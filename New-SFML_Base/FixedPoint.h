@@ -0,0 +1,222 @@
+#pragma once
+
+#include "DoubleDouble.h"
+
+
+// Integer bits, sign included, of every fixed-point format. The kernels
+// only need |z|^2 up to the bailout of 4, with headroom for one step
+// past it: |z|^2 + |c| stays well inside [-128, 128).
+const int FIXED_INTEGER_BITS = 8;
+
+
+// A signed fixed-point number of N 32-bit limbs, least significant
+// first, in two's complement, with 32 N - 8 fractional bits. AMP allows
+// no 64-bit integers, so limbs are 32 bits on both backends, and every
+// operation is plain integer arithmetic: a fixed-point image is the same
+// bit for bit on any CPU or accelerator, at any lane count.
+//
+// Arithmetic saturates rather than wrapping, so an orbit which overflows
+// reads as escaped, as it would in floating point.
+template <int N>
+struct Fixed
+{
+	unsigned int limb[N];
+
+	Fixed() restrict(cpu, amp)
+	{
+		for (int i = 0; i < N; ++i) { limb[i] = 0; }
+	}
+
+	// The nearest representable value towards zero, saturating out of
+	// range. Needs full double support on the accelerator.
+	Fixed(double value) restrict(cpu, amp)
+	{
+		const bool negative = value < 0.0;
+		double magnitude = negative ? -value : value;
+
+		if (magnitude >= 128.0) {
+			*this = Largest(negative);
+			return;
+		}
+
+		// Peel the limbs off from the top; the truncation of a
+		// non-negative double is its floor.
+		magnitude *= 16777216.0; // 2^24
+		for (int i = N - 1; i >= 0; --i) {
+			limb[i] = (unsigned int)magnitude;
+			magnitude = (magnitude - limb[i]) * 4294967296.0; // 2^32
+		}
+
+		if (negative) { *this = -*this; }
+	}
+
+	// hi + lo, so no bits of a double-double view bound are lost.
+	Fixed(const DoubleDouble& value) restrict(cpu, amp)
+	{
+		*this = Fixed(value.hi) + Fixed(value.lo);
+	}
+
+	bool Negative() const restrict(cpu, amp)
+	{
+		return (limb[N - 1] >> 31) != 0;
+	}
+
+	// The largest magnitude, with the given sign.
+	static Fixed Largest(bool negative) restrict(cpu, amp)
+	{
+		Fixed r;
+		r.limb[N - 1] = 0x7FFFFFFF;
+		for (int i = 0; i < N - 1; ++i) { r.limb[i] = 0xFFFFFFFF; }
+		return negative ? -r : r;
+	}
+
+	double ToDouble() const restrict(cpu, amp)
+	{
+		double r = (double)(int)limb[N - 1];
+		for (int i = N - 2; i >= 0; --i) {
+			r = r * 4294967296.0 + limb[i];
+		}
+		for (int i = 0; i < N - 1; ++i) { r *= 1.0 / 4294967296.0; }
+		return r * (1.0 / 16777216.0);
+	}
+};
+
+typedef Fixed<2> Fixed64;
+typedef Fixed<4> Fixed128;
+
+
+// The 64-bit product of a and b, as high and low words. The CPU has a
+// widening multiply; the accelerator builds it from 16-bit halves.
+inline void MulWide(unsigned int a, unsigned int b, unsigned int& hi, unsigned int& lo) restrict(cpu)
+{
+	const unsigned long long p = (unsigned long long)a * b;
+	hi = (unsigned int)(p >> 32);
+	lo = (unsigned int)p;
+}
+
+inline void MulWide(unsigned int a, unsigned int b, unsigned int& hi, unsigned int& lo) restrict(amp)
+{
+	const unsigned int aLow = a & 0xFFFF, aHigh = a >> 16;
+	const unsigned int bLow = b & 0xFFFF, bHigh = b >> 16;
+
+	const unsigned int low = aLow * bLow;
+	const unsigned int middle1 = aHigh * bLow;
+	const unsigned int middle2 = aLow * bHigh;
+	const unsigned int high = aHigh * bHigh;
+
+	// The middle products straddle the two words.
+	const unsigned int middle = (low >> 16) + (middle1 & 0xFFFF) + (middle2 & 0xFFFF);
+	lo = (middle << 16) | (low & 0xFFFF);
+	hi = high + (middle1 >> 16) + (middle2 >> 16) + (middle >> 16);
+}
+
+
+// a, or -a where mask is all ones, without branching on the sign,
+// which is as good as random inside an orbit.
+template <int N>
+inline Fixed<N> NegateIf(const Fixed<N>& a, unsigned int mask) restrict(cpu, amp)
+{
+	// Invert, then add one with carry.
+	Fixed<N> r;
+	unsigned int carry = mask & 1;
+	for (int i = 0; i < N; ++i) {
+		r.limb[i] = (a.limb[i] ^ mask) + carry;
+		carry &= r.limb[i] == 0 ? 1 : 0;
+	}
+	return r;
+}
+
+// All ones for a negative a, else zero.
+template <int N>
+inline unsigned int SignMask(const Fixed<N>& a) restrict(cpu, amp)
+{
+	return 0u - (a.limb[N - 1] >> 31);
+}
+
+template <int N>
+inline Fixed<N> operator-(const Fixed<N>& a) restrict(cpu, amp)
+{
+	return NegateIf(a, 0xFFFFFFFF);
+}
+
+template <int N>
+inline Fixed<N> operator+(const Fixed<N>& a, const Fixed<N>& b) restrict(cpu, amp)
+{
+	Fixed<N> r;
+	unsigned int carry = 0;
+	for (int i = 0; i < N; ++i) {
+		const unsigned int s = a.limb[i] + b.limb[i];
+		r.limb[i] = s + carry;
+		carry = (s < a.limb[i] || r.limb[i] < s) ? 1 : 0;
+	}
+
+	// Only operands of one sign can overflow, into the other.
+	if (a.Negative() == b.Negative() && r.Negative() != a.Negative()) {
+		return Fixed<N>::Largest(a.Negative());
+	}
+	return r;
+}
+
+template <int N>
+inline Fixed<N> operator-(const Fixed<N>& a, const Fixed<N>& b) restrict(cpu, amp)
+{
+	return a + (-b);
+}
+
+// The product of the magnitudes, then the 32 N bits from the fractional
+// point up, truncated towards zero. Loop bounds are all constant, so the
+// compiler unrolls them into straight-line code.
+template <int N>
+inline Fixed<N> operator*(const Fixed<N>& a, const Fixed<N>& b) restrict(cpu, amp)
+{
+	const unsigned int sign = SignMask(a) ^ SignMask(b);
+	const Fixed<N> x = NegateIf(a, SignMask(a));
+	const Fixed<N> y = NegateIf(b, SignMask(b));
+
+	unsigned int product[2 * N];
+	for (int i = 0; i < 2 * N; ++i) { product[i] = 0; }
+
+	for (int i = 0; i < N; ++i) {
+		unsigned int carry = 0;
+		for (int j = 0; j < N; ++j) {
+			unsigned int hi, lo;
+			MulWide(x.limb[i], y.limb[j], hi, lo);
+
+			// hi is at most 2^32 - 2, so it takes both carries.
+			const unsigned int s = product[i + j] + lo;
+			const unsigned int t = s + carry;
+			carry = hi + (s < lo ? 1 : 0) + (t < s ? 1 : 0);
+			product[i + j] = t;
+		}
+		product[i + N] = carry;
+	}
+
+	// Bits past the sign of the result mean it is out of range.
+	if ((product[2 * N - 1] >> (31 - FIXED_INTEGER_BITS)) != 0) {
+		return Fixed<N>::Largest(sign != 0);
+	}
+
+	Fixed<N> r;
+	for (int k = 0; k < N; ++k) {
+		r.limb[k] = (product[N - 1 + k] >> (32 - FIXED_INTEGER_BITS)) | (product[N + k] << FIXED_INTEGER_BITS);
+	}
+	return NegateIf(r, sign);
+}
+
+template <int N>
+inline bool operator<(const Fixed<N>& a, const Fixed<N>& b) restrict(cpu, amp)
+{
+	// The top limb carries the sign; the rest compare unsigned.
+	if (a.limb[N - 1] != b.limb[N - 1]) { return (int)a.limb[N - 1] < (int)b.limb[N - 1]; }
+
+	for (int i = N - 2; i >= 0; --i) {
+		if (a.limb[i] != b.limb[i]) { return a.limb[i] < b.limb[i]; }
+	}
+	return false;
+}
+
+template <int N>
+inline bool operator<=(const Fixed<N>& a, const Fixed<N>& b) restrict(cpu, amp)
+{
+	return !(b < a);
+}
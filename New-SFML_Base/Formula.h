@@ -0,0 +1,243 @@
+#pragma once
+
+#include "LanePack.h"
+#include "OwnComplex.h"
+
+
+// Iteration formulas, as policies the kernels are templated on. Each has:
+//
+//   Start(p, k, z, c)   z0 and c for the point p of the plane, with the
+//                       formula's parameter k (only Julia uses it).
+//   Step(z, c)          one iteration of z.
+//   KnownInterior(x, y) true for points proven never to escape, which
+//                       skip iteration entirely.
+//   StartDerivative(dz) and Derivative(dz, z)
+//                       dz/dc (dz/dz0 for Julia) and its update for one
+//                       Step from z, for distance estimation.
+//
+// Every member is inline and resolved at compile time, so each formula
+// gets its own copy of the tiled, laned and threaded kernels, with no
+// dispatch inside the iteration loop.
+
+
+// |x|, for any scalar with a sign.
+template <typename T>
+inline T Abs(const T& x) restrict(cpu, amp)
+{
+	return x < T(0.0) ? -x : x;
+}
+
+template <typename T, int N>
+inline LanePack<T, N> Abs(const LanePack<T, N>& x) restrict(cpu, amp)
+{
+	LanePack<T, N> r;
+	for (int l = 0; l < N; ++l) { r.v[l] = Abs(x.v[l]); }
+	return r;
+}
+
+// d * sign(x): the derivative d of x, carried through |x|.
+template <typename T>
+inline T ThroughAbs(const T& d, const T& x) restrict(cpu, amp)
+{
+	return x < T(0.0) ? -d : d;
+}
+
+
+// z = z^2 + c, from z = 0 with c the point [3].
+struct MandelbrotStep
+{
+	template <typename T>
+	static void Start(const OwnComplex<T>& p, const OwnComplex<T>& k, OwnComplex<T>& z, OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z = OwnComplex<T>();
+		c = p;
+	}
+
+	template <typename T>
+	static void Step(OwnComplex<T>& z, const OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z.Square();
+		z.Add(c);
+	}
+
+	template <typename T>
+	static void StartDerivative(OwnComplex<T>& dz) restrict(cpu, amp)
+	{
+		dz = OwnComplex<T>();
+	}
+
+	// dz = 2 z dz + 1.
+	template <typename T>
+	static void Derivative(OwnComplex<T>& dz, const OwnComplex<T>& z) restrict(cpu, amp)
+	{
+		dz.Multiply(z);
+		dz.Scale(T(2.0));
+		dz.Add(OwnComplex<T>(T(1.0), T(0.0)));
+	}
+
+	// The main cardioid and the period-2 bulb.
+	template <typename T>
+	static bool KnownInterior(T cx, T cy) restrict(cpu, amp)
+	{
+		T xq = cx - T(0.25);
+		T q = xq * xq + cy * cy;
+		if (q * (q + xq) <= T(0.25) * cy * cy) { return true; }
+
+		T xb = cx + T(1.0);
+		return xb * xb + cy * cy <= T(0.0625);
+	}
+};
+
+
+// z = z^2 + k, from z = the point, for the Julia set of the fixed k.
+struct JuliaStep
+{
+	template <typename T>
+	static void Start(const OwnComplex<T>& p, const OwnComplex<T>& k, OwnComplex<T>& z, OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z = p;
+		c = k;
+	}
+
+	template <typename T>
+	static void Step(OwnComplex<T>& z, const OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z.Square();
+		z.Add(c);
+	}
+
+	// dz/dz0 starts at 1, and is 2 z dz after each step.
+	template <typename T>
+	static void StartDerivative(OwnComplex<T>& dz) restrict(cpu, amp)
+	{
+		dz = OwnComplex<T>(T(1.0), T(0.0));
+	}
+
+	template <typename T>
+	static void Derivative(OwnComplex<T>& dz, const OwnComplex<T>& z) restrict(cpu, amp)
+	{
+		dz.Multiply(z);
+		dz.Scale(T(2.0));
+	}
+
+	template <typename T>
+	static bool KnownInterior(T, T) restrict(cpu, amp) { return false; }
+};
+
+
+// z^N by squaring, written out at compile time: z^4 is two squares,
+// z^3 a square and a multiply.
+template <int N, bool ODD = (N % 2 == 1)>
+struct Power;
+
+template <int N>
+struct Power<N, false>
+{
+	template <typename T>
+	static void Raise(OwnComplex<T>& z, const OwnComplex<T>& base) restrict(cpu, amp)
+	{
+		Power<N / 2>::Raise(z, base);
+		z.Square();
+	}
+};
+
+template <int N>
+struct Power<N, true>
+{
+	template <typename T>
+	static void Raise(OwnComplex<T>& z, const OwnComplex<T>& base) restrict(cpu, amp)
+	{
+		Power<N - 1>::Raise(z, base);
+		z.Multiply(base);
+	}
+};
+
+// z is already z^1.
+template <>
+struct Power<1, true>
+{
+	template <typename T>
+	static void Raise(OwnComplex<T>&, const OwnComplex<T>&) restrict(cpu, amp) {}
+};
+
+
+// z = z^N + c, from z = 0. The bailout of 2 holds for any N >= 2.
+template <int N>
+struct MultibrotStep
+{
+	template <typename T>
+	static void Start(const OwnComplex<T>& p, const OwnComplex<T>& k, OwnComplex<T>& z, OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z = OwnComplex<T>();
+		c = p;
+	}
+
+	template <typename T>
+	static void Step(OwnComplex<T>& z, const OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		const OwnComplex<T> base = z;
+		Power<N>::Raise(z, base);
+		z.Add(c);
+	}
+
+	template <typename T>
+	static void StartDerivative(OwnComplex<T>& dz) restrict(cpu, amp)
+	{
+		dz = OwnComplex<T>();
+	}
+
+	// dz = N z^(N-1) dz + 1.
+	template <typename T>
+	static void Derivative(OwnComplex<T>& dz, const OwnComplex<T>& z) restrict(cpu, amp)
+	{
+		OwnComplex<T> power = z;
+		Power<N - 1>::Raise(power, z);
+		dz.Multiply(power);
+		dz.Scale(T((double)N));
+		dz.Add(OwnComplex<T>(T(1.0), T(0.0)));
+	}
+
+	template <typename T>
+	static bool KnownInterior(T, T) restrict(cpu, amp) { return false; }
+};
+
+
+// z = (|x| + i|y|)^2 + c, from z = 0.
+struct BurningShipStep
+{
+	template <typename T>
+	static void Start(const OwnComplex<T>& p, const OwnComplex<T>& k, OwnComplex<T>& z, OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z = OwnComplex<T>();
+		c = p;
+	}
+
+	template <typename T>
+	static void Step(OwnComplex<T>& z, const OwnComplex<T>& c) restrict(cpu, amp)
+	{
+		z.SetXY(Abs(z.GetX()), Abs(z.GetY()));
+		z.Square();
+		z.Add(c);
+	}
+
+	template <typename T>
+	static void StartDerivative(OwnComplex<T>& dz) restrict(cpu, amp)
+	{
+		dz = OwnComplex<T>();
+	}
+
+	// The fold is not complex-differentiable, so dz/dc is a 2x2 matrix;
+	// this tracks its first column, dz/d(Re c), which is enough for a
+	// distance estimate: dz = 2 |z| (dz through the fold) + 1.
+	template <typename T>
+	static void Derivative(OwnComplex<T>& dz, const OwnComplex<T>& z) restrict(cpu, amp)
+	{
+		dz.SetXY(ThroughAbs(dz.GetX(), z.GetX()), ThroughAbs(dz.GetY(), z.GetY()));
+		dz.Multiply(OwnComplex<T>(Abs(z.GetX()), Abs(z.GetY())));
+		dz.Scale(T(2.0));
+		dz.Add(OwnComplex<T>(T(1.0), T(0.0)));
+	}
+
+	template <typename T>
+	static bool KnownInterior(T, T) restrict(cpu, amp) { return false; }
+};
@@ -0,0 +1,116 @@
+#include "FrameTimer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+thread_local ScopedPhase* ScopedPhase::innermost = nullptr;
+
+
+RollingHistogram::RollingHistogram()
+	: written(0)
+{
+	for (std::atomic<uint32_t>& sample : samples) {
+		sample.store(0, std::memory_order_relaxed);
+	}
+}
+
+void RollingHistogram::Record(uint32_t micros)
+{
+	uint32_t slot = written.load(std::memory_order_relaxed);
+
+	samples[slot % FRAME_WINDOW].store(micros, std::memory_order_relaxed);
+	written.store(slot + 1, std::memory_order_release);
+}
+
+uint32_t RollingHistogram::Last() const
+{
+	uint32_t count = written.load(std::memory_order_acquire);
+	return count == 0 ? 0 : samples[(count - 1) % FRAME_WINDOW].load(std::memory_order_relaxed);
+}
+
+uint32_t RollingHistogram::Percentile(int percent) const
+{
+	uint32_t count = std::min<uint32_t>(written.load(std::memory_order_acquire), FRAME_WINDOW);
+	if (count == 0) { return 0; }
+
+	uint32_t copy[FRAME_WINDOW];
+	for (uint32_t i = 0; i < count; ++i) {
+		copy[i] = samples[i].load(std::memory_order_relaxed);
+	}
+
+	// Nearest-rank percentile.
+	uint32_t rank = std::max<uint32_t>(1, (count * percent + 99) / 100);
+	std::nth_element(copy, copy + rank - 1, copy + count);
+	return copy[rank - 1];
+}
+
+
+FrameTimer::FrameTimer()
+{
+	for (std::atomic<uint32_t>& phase : current) {
+		phase.store(0, std::memory_order_relaxed);
+	}
+}
+
+void FrameTimer::Add(Phase phase, uint32_t micros)
+{
+	current[(int)phase].fetch_add(micros, std::memory_order_relaxed);
+}
+
+void FrameTimer::EndFrame()
+{
+	uint32_t frame = 0;
+
+	for (int i = 0; i < (int)Phase::COUNT; ++i) {
+		uint32_t micros = current[i].exchange(0, std::memory_order_relaxed);
+		histograms[i].Record(micros);
+		frame += micros;
+	}
+	totals.Record(frame);
+}
+
+const char* FrameTimer::Name(Phase phase)
+{
+	static const char* names[(int)Phase::COUNT] = {
+		"input", "iterate", "blur", "repack", "upload", "draw", "display"
+	};
+	return names[(int)phase];
+}
+
+std::string FrameTimer::Summary() const
+{
+	std::string summary = "phase       last     p99 (ms)\n";
+	char line[64];
+
+	for (int i = 0; i < (int)Phase::COUNT; ++i) {
+		std::snprintf(line, sizeof(line), "%-8s %7.2f %7.2f\n", Name((Phase)i),
+			histograms[i].Last() / 1000.0, histograms[i].Percentile(99) / 1000.0);
+		summary += line;
+	}
+
+	std::snprintf(line, sizeof(line), "%-8s %7.2f %7.2f", "frame",
+		totals.Last() / 1000.0, totals.Percentile(99) / 1000.0);
+	return summary + line;
+}
+
+
+ScopedPhase::ScopedPhase(FrameTimer& frameTimer, Phase timed)
+	: timer(frameTimer),
+	phase(timed),
+	start(the_phase_clock::now()),
+	childMicros(0),
+	parent(innermost)
+{
+	innermost = this;
+}
+
+ScopedPhase::~ScopedPhase()
+{
+	uint32_t elapsed = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+		the_phase_clock::now() - start).count();
+
+	innermost = parent;
+	if (parent) { parent->childMicros += elapsed; }
+
+	timer.Add(phase, elapsed > childMicros ? elapsed - childMicros : 0);
+}
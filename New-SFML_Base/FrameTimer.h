@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Number of recent frames kept for percentile reporting.
+const int FRAME_WINDOW = 240;
+
+
+// The parts of a frame that are timed separately.
+enum class Phase { INPUT, ITERATE, BLUR, REPACK, UPLOAD, DRAW, DISPLAY, COUNT };
+
+
+// A fixed window of recent samples, recorded by one thread. Readers never
+// block; they copy the window and may see one sample mid-update.
+class RollingHistogram
+{
+private:
+	std::atomic<uint32_t> samples[FRAME_WINDOW];
+	std::atomic<uint32_t> written;
+
+public:
+	RollingHistogram();
+
+	void Record(uint32_t micros);
+
+	uint32_t Last() const;
+	uint32_t Percentile(int percent) const;
+};
+
+
+// Accumulates phase times for the current frame and keeps a
+// rolling histogram of each phase over recent frames.
+class FrameTimer
+{
+private:
+	RollingHistogram histograms[(int)Phase::COUNT];
+	RollingHistogram totals;
+
+	// Time spent in each phase so far this frame.
+	std::atomic<uint32_t> current[(int)Phase::COUNT];
+
+public:
+	FrameTimer();
+
+	void Add(Phase phase, uint32_t micros);
+
+	// Close the current frame and start accumulating the next.
+	void EndFrame();
+
+	uint32_t Last(Phase phase) const { return histograms[(int)phase].Last(); };
+	uint32_t P99(Phase phase) const { return histograms[(int)phase].Percentile(99); };
+
+	static const char* Name(Phase phase);
+
+	// A small table of last-frame and p99 times, in milliseconds.
+	std::string Summary() const;
+};
+
+
+// Times its own lifetime as one phase. Nested scopes are subtracted
+// from the enclosing one, so each phase reports only its own time.
+class ScopedPhase
+{
+private:
+	typedef std::chrono::steady_clock the_phase_clock;
+
+	FrameTimer& timer;
+	Phase phase;
+	the_phase_clock::time_point start;
+
+	uint32_t childMicros;
+	ScopedPhase* parent;
+
+	static thread_local ScopedPhase* innermost;
+
+public:
+	ScopedPhase(FrameTimer& frameTimer, Phase timed);
+	~ScopedPhase();
+};
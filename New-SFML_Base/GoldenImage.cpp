@@ -0,0 +1,321 @@
+#include "GoldenImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+// Import things we need from the standard library
+using std::cout;
+using std::endl;
+
+// Identifies golden files, and the layout of their header.
+const char GOLDEN_MAGIC[4] = { 'M', 'B', 'G', 'I' };
+const uint32_t GOLDEN_FORMAT = 1;
+
+// Tile size for the progressive check; not a divisor of the golden
+// size, so the edge tiles are clipped.
+const int GOLDEN_PROGRESSIVE_TILE = 48;
+
+
+GoldenSuite::GoldenSuite(const std::string& goldenDirectory)
+	: directory(goldenDirectory),
+	backends({ Backend::AMP, Backend::CPU })
+{
+	scenes = StandardScenes();
+}
+
+bool GoldenSuite::selectScene(const std::string& name)
+{
+	const BenchScene* scene = FindScene(name);
+	if (!scene) {
+		cout << "Unknown scene " << name << endl;
+		return false;
+	}
+
+	scenes.assign(1, *scene);
+	return true;
+}
+
+std::string GoldenSuite::GoldenPath(const BenchScene& scene) const
+{
+	return directory + "/" + scene.name + ".mbgi";
+}
+
+GoldenTolerance GoldenSuite::ToleranceFor(const std::string& scene)
+{
+	// Shallow views should match exactly, bar the odd pixel on the set's
+	// edge. Deep and long-running views are chaotic in single precision,
+	// so any change to operation order moves more of their boundary.
+	if (scene == "home") { return { 0, 0.5 }; }
+	if (scene == "seahorse") { return { 0, 1.0 }; }
+	if (scene == "cardioid") { return { 0, 0.5 }; }
+	if (scene == "filament") { return { 2, 5.0 }; }
+	if (scene == "deep") { return { 0, 2.0 }; }
+
+	return { 0, 1.0 };
+}
+
+void GoldenSuite::ReferenceRender(const BenchScene& scene, int width, int height, std::vector<uint32_t>& counts)
+{
+	// View bounds exactly as ComputeView narrows them to float.
+	double viewHeight = scene.viewWidth * height / width;
+	const float left = (float)(scene.centreX - scene.viewWidth / 2);
+	const float right = (float)(scene.centreX + scene.viewWidth / 2);
+	const float top = (float)(scene.centreY + viewHeight / 2);
+	const float bottom = (float)(scene.centreY - viewHeight / 2);
+
+	const unsigned int maxIterations = scene.iterations;
+
+	counts.resize(width * height);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const float cx = left + (x * (right - left) / width);
+			const float cy = bottom + (y * (top - bottom) / height);
+
+			// z = z^2 + c from z = 0 until |z| reaches 2.
+			float zx = 0.0f, zy = 0.0f;
+			unsigned int iterations = 0;
+			while (std::sqrt(zx * zx + zy * zy) < 2.0f && iterations < maxIterations) {
+				float nx = zx * zx - zy * zy;
+				float ny = zy * zx + zx * zy;
+				zx = nx + cx;
+				zy = ny + cy;
+
+				++iterations;
+			}
+			counts[y * width + x] = iterations;
+		}
+	}
+}
+
+void WriteWord(std::ofstream& out, uint32_t word)
+{
+	const char bytes[4] = { char(word & 0xFF), char((word >> 8) & 0xFF), char((word >> 16) & 0xFF), char((word >> 24) & 0xFF) };
+	out.write(bytes, 4);
+}
+
+uint32_t ReadWord(const unsigned char* bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+bool GoldenSuite::SaveGolden(const char* filename, int width, int height, unsigned int maxIterations, const std::vector<uint32_t>& counts)
+{
+	std::ofstream outfile(filename, std::ofstream::binary);
+
+	// Magic, format, suite version, width, height, iteration limit.
+	outfile.write(GOLDEN_MAGIC, 4);
+	WriteWord(outfile, GOLDEN_FORMAT);
+	WriteWord(outfile, SCENE_SUITE_VERSION);
+	WriteWord(outfile, width);
+	WriteWord(outfile, height);
+	WriteWord(outfile, maxIterations);
+
+	for (uint32_t n : counts) {
+		WriteWord(outfile, n);
+	}
+
+	outfile.close();
+	if (!outfile) {
+		cout << "Error writing to " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+bool GoldenSuite::LoadGolden(const char* filename, int& width, int& height, unsigned int& maxIterations, std::vector<uint32_t>& counts)
+{
+	std::ifstream infile(filename, std::ifstream::binary);
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+
+	if (!infile.is_open() || data.size() < 24 || !std::equal(GOLDEN_MAGIC, GOLDEN_MAGIC + 4, data.begin())) {
+		cout << "Unable to read golden image " << filename << endl;
+		return false;
+	}
+	if (ReadWord(&data[4]) != GOLDEN_FORMAT || ReadWord(&data[8]) != (uint32_t)SCENE_SUITE_VERSION) {
+		cout << "Golden image " << filename << " is from another suite version; regenerate it with --golden --update" << endl;
+		return false;
+	}
+
+	width = ReadWord(&data[12]);
+	height = ReadWord(&data[16]);
+	maxIterations = ReadWord(&data[20]);
+
+	if (data.size() != 24 + (size_t)width * height * 4) {
+		cout << "Golden image " << filename << " is truncated" << endl;
+		return false;
+	}
+
+	counts.resize(width * height);
+	for (size_t i = 0; i < counts.size(); ++i) {
+		counts[i] = ReadWord(&data[24 + i * 4]);
+	}
+	return true;
+}
+
+bool GoldenSuite::Update()
+{
+	for (const BenchScene& scene : scenes) {
+		std::vector<uint32_t> counts;
+		ReferenceRender(scene, GOLDEN_WIDTH, GOLDEN_HEIGHT, counts);
+
+		std::string path = GoldenPath(scene);
+		if (!SaveGolden(path.c_str(), GOLDEN_WIDTH, GOLDEN_HEIGHT, scene.iterations, counts)) { return false; }
+
+		cout << "Wrote " << path << endl;
+	}
+	return true;
+}
+
+GoldenReport GoldenSuite::Compare(const char* backend, const BenchScene& scene,
+	const std::vector<uint32_t>& golden, const std::vector<uint32_t>& actual)
+{
+	const GoldenTolerance tolerance = ToleranceFor(scene.name);
+
+	GoldenReport report;
+	report.backend = backend;
+	report.scene = scene.name;
+	report.pixels = (int)golden.size();
+	report.mismatched = 0;
+	report.maxDelta = 0;
+	report.firstX = report.firstY = -1;
+
+	double totalDelta = 0.0;
+	for (size_t i = 0; i < golden.size(); ++i) {
+		unsigned int delta = golden[i] > actual[i] ? golden[i] - actual[i] : actual[i] - golden[i];
+		totalDelta += delta;
+		report.maxDelta = std::max(report.maxDelta, delta);
+
+		if (delta > tolerance.iterationSlack) {
+			if (report.mismatched == 0) {
+				report.firstX = (int)(i % GOLDEN_WIDTH);
+				report.firstY = (int)(i / GOLDEN_WIDTH);
+			}
+			++report.mismatched;
+		}
+	}
+	report.meanDelta = totalDelta / report.pixels;
+	report.passed = 100.0 * report.mismatched / report.pixels <= tolerance.mismatchPercent;
+
+	return report;
+}
+
+void GoldenSuite::WriteDiff(const GoldenReport& report,
+	const std::vector<uint32_t>& golden, const std::vector<uint32_t>& actual)
+{
+	// Mismatches in red over a dim copy of the golden image.
+	std::vector<uint32_t> diff(golden.size());
+	for (size_t i = 0; i < golden.size(); ++i) {
+		if (golden[i] != actual[i]) {
+			diff[i] = 0xFF0000;
+		}
+		else {
+			uint32_t grey = golden[i] & 0x3F;
+			diff[i] = (grey << 16) | (grey << 8) | grey;
+		}
+	}
+
+	std::string path = diffDirectory + "/" + report.backend + "_" + report.scene + "_diff.tga";
+	Mandelbrot::WriteTga(path.c_str(), diff.data(), GOLDEN_WIDTH, GOLDEN_HEIGHT);
+}
+
+void GoldenSuite::UseGoldenSettings(Mandelbrot& mandel, Backend backend, const BenchScene& scene)
+{
+	mandel.setBackend(backend);
+	mandel.setMaxIterations((float)scene.iterations);
+
+	// The goldens are float Mandelbrot escape counts, whatever the
+	// command line made the default for new instances.
+	mandel.setFormula(Formula::MANDELBROT);
+	mandel.setPrecision(Precision::FLOAT);
+	mandel.setDistanceEstimation(false);
+}
+
+bool GoldenSuite::CheckProgressive(Backend backend, const BenchScene& scene)
+{
+	const double left = scene.centreX - scene.viewWidth / 2;
+	const double right = scene.centreX + scene.viewWidth / 2;
+	const double top = scene.centreY + scene.viewWidth * GOLDEN_HEIGHT / GOLDEN_WIDTH / 2;
+	const double bottom = scene.centreY - scene.viewWidth * GOLDEN_HEIGHT / GOLDEN_WIDTH / 2;
+
+	Mandelbrot whole(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+	UseGoldenSettings(whole, backend, scene);
+	whole.ComputeMandelbrot(left, right, top, bottom);
+
+	Mandelbrot progressive(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+	UseGoldenSettings(progressive, backend, scene);
+	progressive.StartProgressive(left, right, top, bottom, 0, GOLDEN_PROGRESSIVE_TILE);
+	progressive.ContinueProgressive(std::numeric_limits<double>::infinity());
+
+	// Tiles map their pixels as the whole frame does, so nothing may differ.
+	const bool identical = progressive.GetIterations() == whole.GetIterations()
+		&& progressive.GetImage() == whole.GetImage();
+
+	cout << std::left << std::setw(10) << Mandelbrot::BackendName(backend) << std::setw(16) << scene.name << std::right
+		<< (identical ? "pass " : "FAIL ") << "progressive frame " << (identical ? "identical to" : "differs from")
+		<< " a whole render" << endl;
+	return identical;
+}
+
+int GoldenSuite::Check()
+{
+	reports.clear();
+	int failures = 0;
+
+	for (const BenchScene& scene : scenes) {
+		std::vector<uint32_t> golden;
+		int width, height;
+		unsigned int maxIterations;
+
+		std::string path = GoldenPath(scene);
+		if (!LoadGolden(path.c_str(), width, height, maxIterations, golden)) {
+			++failures;
+			continue;
+		}
+		if (width != GOLDEN_WIDTH || height != GOLDEN_HEIGHT || maxIterations != (unsigned int)scene.iterations) {
+			cout << "Golden image " << path << " does not match its scene; regenerate it with --golden --update" << endl;
+			++failures;
+			continue;
+		}
+
+		// The reference first, so a bad golden file is not blamed on a backend.
+		std::vector<std::pair<std::string, std::vector<uint32_t>>> renders;
+		renders.emplace_back("reference", std::vector<uint32_t>());
+		ReferenceRender(scene, GOLDEN_WIDTH, GOLDEN_HEIGHT, renders.back().second);
+
+		for (Backend backend : backends) {
+			Mandelbrot mandel(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+			UseGoldenSettings(mandel, backend, scene);
+			mandel.ComputeView(scene.centreX, scene.centreY, scene.viewWidth);
+
+			const ImageBuffer& counts = mandel.GetIterations();
+			renders.emplace_back(backend == Backend::CPU ? "cpu" : "amp", std::vector<uint32_t>(counts.begin(), counts.end()));
+
+			if (!CheckProgressive(backend, scene)) { ++failures; }
+		}
+
+		for (const auto& render : renders) {
+			GoldenReport report = Compare(render.first.c_str(), scene, golden, render.second);
+			reports.push_back(report);
+
+			cout << std::left << std::setw(10) << report.backend << std::setw(16) << report.scene << std::right
+				<< (report.passed ? "pass " : "FAIL ") << std::setw(6) << report.mismatched << "/" << report.pixels
+				<< " mismatched (" << std::fixed << std::setprecision(2) << 100.0 * report.mismatched / report.pixels
+				<< "% of " << ToleranceFor(scene.name).mismatchPercent << "% allowed), max delta " << report.maxDelta
+				<< ", mean delta " << std::setprecision(3) << report.meanDelta;
+			if (report.mismatched > 0) {
+				cout << ", first at (" << report.firstX << ", " << report.firstY << ")";
+			}
+			cout << endl;
+
+			if (!report.passed) {
+				++failures;
+				if (!diffDirectory.empty()) { WriteDiff(report, golden, render.second); }
+			}
+		}
+	}
+
+	cout << endl << (failures == 0 ? "All golden images match." : "Golden image check FAILED.") << endl;
+	return failures;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Mandelbrot.h"
+#include "SceneSuite.h"
+
+#include <string>
+#include <vector>
+
+// Resolution of the stored golden images. Small, so the files can live
+// in the repository and a full check runs in seconds.
+const int GOLDEN_WIDTH = 128;
+const int GOLDEN_HEIGHT = 128;
+
+// Where golden images are kept, relative to the working directory.
+const char* const DEFAULT_GOLDEN_DIR = "golden";
+
+
+// How far a backend may drift from the reference on one scene.
+struct GoldenTolerance
+{
+	// Iteration counts within this many of the golden count match.
+	unsigned int iterationSlack;
+
+	// Percentage of pixels allowed to mismatch before the scene fails.
+	double mismatchPercent;
+};
+
+
+// Outcome of comparing one backend's render of one scene with its golden.
+struct GoldenReport
+{
+	std::string backend;
+	std::string scene;
+
+	int pixels;
+	int mismatched;
+	unsigned int maxDelta;
+	double meanDelta;
+
+	// First mismatching pixel, or -1 if none.
+	int firstX, firstY;
+
+	bool passed;
+};
+
+
+// Checks every render backend against iteration-count images produced
+// by a plain scalar reference of the original kernel.
+class GoldenSuite
+{
+private:
+	std::string directory;
+	std::string diffDirectory;
+
+	std::vector<Backend> backends;
+	std::vector<BenchScene> scenes;
+	std::vector<GoldenReport> reports;
+
+	std::string GoldenPath(const BenchScene& scene) const;
+
+	GoldenReport Compare(const char* backend, const BenchScene& scene,
+		const std::vector<uint32_t>& golden, const std::vector<uint32_t>& actual);
+	void WriteDiff(const GoldenReport& report,
+		const std::vector<uint32_t>& golden, const std::vector<uint32_t>& actual);
+
+	// Set up a renderer as the golden images were made, for the scene.
+	static void UseGoldenSettings(Mandelbrot& mandel, Backend backend, const BenchScene& scene);
+
+	// Whether a progressive render of the scene, tile by tile, is exactly
+	// the image a whole render of the same view gives.
+	static bool CheckProgressive(Backend backend, const BenchScene& scene);
+
+public:
+	GoldenSuite(const std::string& goldenDirectory = DEFAULT_GOLDEN_DIR);
+
+	void setBackends(const std::vector<Backend>& use) { backends = use; };
+
+	// Also write an image of where each failing scene mismatched.
+	void setDiffDirectory(const std::string& path) { diffDirectory = path; };
+
+	// Restrict the check to a single standard scene.
+	bool selectScene(const std::string& name);
+
+	// Regenerate every golden image from the reference.
+	bool Update();
+
+	// Render every scene on every backend, and on the reference itself,
+	// and compare with the goldens. Returns the number of failures.
+	int Check();
+
+	const std::vector<GoldenReport>& getReports() { return reports; };
+
+	// The original kernel, one pixel at a time, without shortcuts. Uses
+	// the same view bounds and pixel mapping as Mandelbrot::ComputeView.
+	static void ReferenceRender(const BenchScene& scene, int width, int height, std::vector<uint32_t>& counts);
+
+	static GoldenTolerance ToleranceFor(const std::string& scene);
+
+	// Golden files are a small header then little-endian counts.
+	static bool LoadGolden(const char* filename, int& width, int& height, unsigned int& maxIterations, std::vector<uint32_t>& counts);
+	static bool SaveGolden(const char* filename, int width, int height, unsigned int maxIterations, const std::vector<uint32_t>& counts);
+};
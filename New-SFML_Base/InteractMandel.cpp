@@ -1,52 +1,298 @@
 #include "InteractMandel.h"
 #include <cmath>
+#include <limits>
 
 InteractMandel::InteractMandel(sf::RenderWindow* hwnd, Input* in)
-	: leftMouseDrag(false),
+	: previewIndex(0),
+	tileQuads(sf::Quads),
+	tilesShown(0),
+	previewVisible(false),
+	leftMouseDrag(false),
 	middleMouseDrag(false),
-	left(-2.0f),
-	right(1.0f), // 2.0f
-	top(1.125f),
-	bottom(-1.125f),
-	sample(0),
-	blurApplied(false)
+	left(-2.0),
+	right(1.0), // 2.0
+	top(1.125),
+	bottom(-1.125),
+	frameLeft(left), frameRight(right),
+	frameTop(top), frameBottom(bottom),
+	previewLeft(left), previewRight(right),
+	previewTop(top), previewBottom(bottom),
+	blurApplied(false),
+	autoIterations(false),
+	progressive(true),
+	overlayVisible(false),
+	overlayAge(OVERLAY_REFRESH_FRAMES)
 {
 	window = hwnd;
 	input = in;
 
-	// Create an empty texture.
-	if (!mandelTexture.create(WIDTH, HEIGHT)) {
+	// Create empty textures.
+	if (!mandelTexture.create(WIDTH, HEIGHT)
+		|| !previewTargets[0].create(WIDTH, HEIGHT) || !previewTargets[1].create(WIDTH, HEIGHT)) {
 		std::cout << "Failed to create mandelTexture.";
 		abort();
 	}
 
+	// Initialise timing overlay; without a font, T prints timings instead.
+	overlayFontLoaded = false;
+	for (const char* path : OVERLAY_FONTS) {
+		if (overlayFont.loadFromFile(path)) {
+			overlayFontLoaded = true;
+			break;
+		}
+	}
+	overlayText.setFont(overlayFont);
+	overlayText.setCharacterSize(14);
+	overlayText.setFillColor(sf::Color::Green);
+	overlayText.setPosition(8.0f, 8.0f);
+
 	// Initialise zoom window qualities.
 	zoomWindow.setFillColor(sf::Color::Transparent);
 	zoomWindow.setOutlineColor(sf::Color::White);
 	zoomWindow.setOutlineThickness(-3.0f);
 
+	// Initialise the Julia inset, in the top-right corner.
+	juliaFrame.setSize(sf::Vector2f((float)JULIA_PREVIEW_SIZE, (float)JULIA_PREVIEW_SIZE));
+	juliaFrame.setPosition(WIDTH - JULIA_PREVIEW_SIZE - JULIA_INSET_MARGIN, JULIA_INSET_MARGIN);
+	juliaFrame.setFillColor(sf::Color::Black);
+	juliaFrame.setOutlineColor(sf::Color::White);
+	juliaFrame.setOutlineThickness(2.0f);
+	juliaSprite.setPosition(juliaFrame.getPosition());
+
 	// Compute Mandelbrot - initialise image data.
-	mandel.ComputeMandelbrot(left, right, top, bottom);
+	ComputeImage();
 }
 
 void InteractMandel::HandleInput(float frame_time)
 {
+	// Work done by the handlers below is timed as its own phase.
+	ScopedPhase timed(frameTimer, Phase::INPUT);
+
 	// Press Esc key to close window.
 	if (input->isKeyDown(sf::Keyboard::Escape)) {
 		window->close();
 	}
-	// Enter to output screen to a .tga.
+	// Enter to output screen to a .tga, with its cost heatmap.
 	if (input->isKeyDown(sf::Keyboard::Enter)) {
+		// Any unfinished tiles are rendered first, so the file is full resolution.
+		if (!mandel.ProgressiveComplete()) { FinishProgressive(); }
+
 		mandel.WriteTga("output.tga");
+
+		const RenderStats& stats = mandel.ComputeStats();
+		mandel.WriteCostHeatmap("output_cost.tga");
+		std::cout << "Iterations: " << stats.iterations << ", " << stats.escaped << " escaped, "
+			<< stats.interior << " interior, " << stats.shortcut << " shortcut, " << stats.mirrored << " mirrored" << std::endl;
+	}
+
+	// Toggle the timing overlay on T press.
+	if (input->isKeyDown(sf::Keyboard::T)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::T);
+
+		overlayVisible = !overlayVisible;
+		if (overlayVisible && !overlayFontLoaded) {
+			std::cout << frameTimer.Summary() << std::endl;
+		}
+	}
+
+	// Cycle float, double, double-double and fixed-point iteration on P press.
+	if (input->isKeyDown(sf::Keyboard::P)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::P);
+
+		Precision next = Precision(((int)mandel.getPrecision() + 1) % ((int)Precision::FIXED128 + 1));
+		mandel.setPrecision(next);
+		std::cout << "Precision: " << Mandelbrot::PrecisionName(next) << std::endl;
+
+		// Compute Mandelbrot - update image data.
+		ComputeImage();
+	}
+
+	// Cycle through the iteration formulas on F press.
+	if (input->isKeyDown(sf::Keyboard::F)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::F);
+
+		Formula next = Formula(((int)mandel.getFormula() + 1) % ((int)Formula::BURNING_SHIP + 1));
+		mandel.setFormula(next);
+		std::cout << "Formula: " << Mandelbrot::FormulaName(next) << std::endl;
+
+		// Compute Mandelbrot - update image data.
+		ComputeImage();
+	}
+
+	// Toggle distance-estimated shading on D press.
+	if (input->isKeyDown(sf::Keyboard::D)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::D);
+
+		mandel.setDistanceEstimation(!mandel.getDistanceEstimation());
+		std::cout << "Distance estimation: " << (mandel.getDistanceEstimation() ? "on" : "off") << std::endl;
+
+		// Compute Mandelbrot - update image data.
+		ComputeImage();
+	}
+
+	// Toggle the Julia inset on J press.
+	if (input->isKeyDown(sf::Keyboard::J)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::J);
+
+		if (juliaPreview) { juliaPreview.reset(); }
+		else { juliaPreview.reset(new JuliaPreview()); }
+	}
+
+	// Toggle automatic iteration limits on A press.
+	if (input->isKeyDown(sf::Keyboard::A)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::A);
+
+		autoIterations = !autoIterations;
+		std::cout << "Automatic iterations: " << (autoIterations ? "on" : "off") << std::endl;
+
+		// Compute Mandelbrot - update image data.
+		ComputeImage();
+	}
+
+	// Toggle budgeted, progressive rendering on B press.
+	if (input->isKeyDown(sf::Keyboard::B)) {
+
+		// Press should not be mistaken as a hold.
+		input->setKeyUp(sf::Keyboard::B);
+
+		progressive = !progressive;
+		std::cout << "Progressive rendering: " << (progressive ? "on" : "off") << std::endl;
+
+		// Compute Mandelbrot - update image data.
+		ComputeImage();
 	}
 
-	ERZoomReset();
+	FollowJulia();
+	ERZoomReset(frame_time);
 	ComputeZoomWindow();
 	DragViewWindow();
 	ControlIterations();
+	AnimateZoom(frame_time);
 }
 
-void InteractMandel::ERZoomReset()
+void InteractMandel::ComputeImage()
+{
+	{
+		ScopedPhase timed(frameTimer, Phase::ITERATE);
+
+		// Once settled, a view crossing the real axis is nudged onto rows
+		// which reflect onto each other, so half of what it shares with
+		// its reflection is mirrored; mid-zoom, that would shake the view.
+		if (!zoom.Active()) { mandel.AlignToAxis(top, bottom); }
+
+		// The probe is part of the frame's iteration cost. Mid-zoom, the
+		// limit waits for the zoom to settle.
+		if (autoIterations && !zoom.Active()) {
+			const int previous = mandel.getMaxIterations();
+			IterationChoice choice = mandel.ChooseIterations(left, right, top, bottom);
+
+			if (choice.limit != previous) {
+				std::cout << "Max iterations: " << choice.limit << " (" << choice.depthLimit << " from depth, "
+					<< choice.probes << " probes, " << 100.0 * choice.unresolved << "% unresolved)" << std::endl;
+			}
+		}
+
+		// A progressive frame starts from its coarse level; Update
+		// renders its tiles over the frames that follow. Mid-zoom, the
+		// tiles are smaller, and the coarse level is left out when the
+		// preview covers the whole view.
+		if (progressive) {
+			const bool covered = StartPreview();
+
+			if (zoom.Active()) {
+				mandel.StartProgressive(left, right, top, bottom, covered ? 0 : ZOOM_COARSE_FACTOR, ZOOM_TILE);
+			}
+			else { mandel.StartProgressive(left, right, top, bottom); }
+			return;
+		}
+
+		previewVisible = false;
+		frameLeft = left; frameRight = right;
+		frameTop = top; frameBottom = bottom;
+
+		mandel.ComputeMandelbrot(left, right, top, bottom);
+	}
+
+	// If necessary, apply blur.
+	if (blurApplied) {
+		ScopedPhase timed(frameTimer, Phase::BLUR);
+		mandel.ApplyBlur();
+	}
+}
+
+bool InteractMandel::StartPreview()
+{
+	// A frame of the same view, after a change of formula or limit,
+	// would be a preview of the wrong image.
+	const bool moved = left != frameLeft || right != frameRight || top != frameTop || bottom != frameBottom;
+
+	if (moved) {
+		// What the screen shows now, preview and tiles included, becomes
+		// the preview, so a frame a zoom leaves unfinished still carries
+		// its tiles into the next. It is drawn as it is on screen, so the
+		// old preview only shows if it is showing now.
+		sf::RenderTexture& target = previewTargets[1 - previewIndex];
+		target.clear();
+		DrawFrame(target);
+		target.display();
+		previewIndex = 1 - previewIndex;
+
+		previewLeft = frameLeft; previewRight = frameRight;
+		previewTop = frameTop; previewBottom = frameBottom;
+	}
+	previewVisible = moved;
+
+	frameLeft = left; frameRight = right;
+	frameTop = top; frameBottom = bottom;
+
+	// The texture's pixel (u, v) is at the point previewLeft + u * its
+	// pixel width, and the view puts that point at screen x below; so too
+	// vertically, as both put the bottom of the view in row 0.
+	const double scaleX = (previewRight - previewLeft) / (right - left);
+	const double scaleY = (previewTop - previewBottom) / (top - bottom);
+	previewSprite.setTexture(previewTargets[previewIndex].getTexture(), true);
+	previewSprite.setScale((float)scaleX, (float)scaleY);
+	previewSprite.setPosition((float)((previewLeft - left) / (right - left) * WIDTH),
+		(float)((previewBottom - bottom) / (top - bottom) * HEIGHT));
+
+	tileQuads.clear();
+	tilesShown = 0;
+
+	return previewVisible && previewLeft <= left && previewRight >= right && previewBottom <= bottom && previewTop >= top;
+}
+
+void InteractMandel::ContinueProgressive(double budget)
+{
+	{
+		ScopedPhase timed(frameTimer, Phase::ITERATE);
+		if (!mandel.ContinueProgressive(budget)) { return; }
+	}
+
+	// Blur waits for the last tile, as it spans tiles.
+	if (blurApplied) {
+		ScopedPhase timed(frameTimer, Phase::BLUR);
+		mandel.ApplyBlur();
+	}
+}
+
+void InteractMandel::FinishProgressive()
+{
+	ContinueProgressive(std::numeric_limits<double>::infinity());
+}
+
+void InteractMandel::ERZoomReset(float frame_time)
 {
 	// Reset view region to full, upon Z key pressed.
 	if (input->isKeyDown(sf::Keyboard::Z)) {
@@ -54,19 +300,21 @@ void InteractMandel::ERZoomReset()
 		// Press should not be mistaken as a hold.
 		input->setKeyUp(sf::Keyboard::Z);
 
-		left = -2.0f; right = 1.0f; // 2.0f
+		zoom.Stop();
+		left = -2.0; right = 1.0; // 2.0
 		top = 1.125; bottom = -1.125;
 
 		// Compute Mandelbrot - update image data.
-		mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+		ComputeImage();
 	}
 
 	// Scale back - previously, a zoom 'undo.'
 	if (input->isRightMousePressed()) {
+		zoom.Stop();
 		TransformImage((WIDTH / 2.0f), (HEIGHT / 2.0f), 1.0f / 5.0f);
 
 		// Compute Mandelbrot - update image data.
-		mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+		ComputeImage();
 	}
 
 	// Toggle image blur effect on C press.
@@ -78,22 +326,28 @@ void InteractMandel::ERZoomReset()
 		blurApplied = !blurApplied;
 
 		if (blurApplied) {
-			// Compute blur - update image data.
-			mandel.ApplyBlur();
+			// An unfinished progressive frame is blurred once complete.
+			if (mandel.ProgressiveComplete()) {
+				// Compute blur - update image data.
+				ScopedPhase timed(frameTimer, Phase::BLUR);
+				mandel.ApplyBlur();
+			}
 		}
 		else {
 			// Compute Mandelbrot - overwrite image data.
-			mandel.ComputeMandelbrot(left, right, top, bottom);
+			ComputeImage();
 		}
 	}
-	/*if (input->isKeyDown(sf::Keyboard::R)) {
-		zoom += 0.010001f;
+
+	// Hold R to zoom in, or E to zoom out, about the centre; AnimateZoom
+	// moves the view. (The ER function name sounded really neato.)
+	const double octaves = std::log2(ZOOM_KEY_RATE) * frame_time;
+	if (input->isKeyDown(sf::Keyboard::R)) {
+		zoom.Add(octaves, WIDTH / 2.0, HEIGHT / 2.0);
 	}
 	if (input->isKeyDown(sf::Keyboard::E)) {
-		zoom -= 0.010001f;
+		zoom.Add(-octaves, WIDTH / 2.0, HEIGHT / 2.0);
 	}
-	// Rudimentary attempt at zoom in/out.
-	// I kept the ER function name as it sounded really neato.*/
 }
 
 void InteractMandel::ComputeZoomWindow()
@@ -139,11 +393,12 @@ void InteractMandel::ComputeZoomWindow()
 		}
 		SCALE = std::abs(SCALE);
 
+		zoom.Stop();
 		TransformImage(centreX, centreY, SCALE);
 		zoomWindow.setSize(sf::Vector2f(0.0f, 0.0f));
 
 		// Compute Mandelbrot - update image data.
-		mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+		ComputeImage();
 
 		leftMouseDrag = false;
 	}
@@ -176,41 +431,52 @@ void InteractMandel::DragViewWindow()
 			TransformImage(centreX, centreY, 1.0f);
 
 			// Compute Mandelbrot - update image data.
-			mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+			ComputeImage();
 		}
 	}
 	else if (middleMouseDrag) { middleMouseDrag = false; }
 }
 
-void InteractMandel::TransformImage(float x, float y, float z)
+void InteractMandel::TransformImage(double x, double y, double z)
 {
 	// Align the centre point of the drawn rectangle
 	// with the centre of the complex plane.
 
-	float real = left + (right - left) * x / WIDTH;
-	float imaginary = bottom + (top - bottom) * y / HEIGHT;
+	double real = left + (right - left) * x / WIDTH;
+	double imaginary = bottom + (top - bottom) * y / HEIGHT;
 
 	// Apply transformation to the Mandelbrot frame.
-	float leftTemp = real - (right - left) / 2 / z;
+	double leftTemp = real - (right - left) / 2 / z;
 	right = real + (right - left) / 2 / z;
 	left = leftTemp;
 
-	float bottomTemp = imaginary - (top - bottom) / 2 / z;
+	double bottomTemp = imaginary - (top - bottom) / 2 / z;
 	top = imaginary + (top - bottom) / 2 / z;
 	bottom = bottomTemp;
 }
 
 void InteractMandel::ControlIterations()
 {
-	// Increase the maximum iterations with a forward* scroll.
+	// The wheel zooms about the cursor, a step per notch, forward* to
+	// zoom in.
+	const bool shift = input->isKeyDown(sf::Keyboard::LShift) || input->isKeyDown(sf::Keyboard::RShift);
+
+	if (input->isVerticalWheelScrolling() && !shift) {
+		zoom.Add(input->getScrollDelta() * std::log2(ZOOM_WHEEL_STEP), input->getMouseX(), input->getMouseY());
+	}
+
+	// Increase the maximum iterations with a forward* Shift+scroll.
+
+	if (input->isVerticalWheelScrolling() && shift) {
+		// Setting a limit by hand leaves automatic mode.
+		autoIterations = false;
 
-	if (input->isVerticalWheelScrolling()) {
 		if (input->getScrollDelta() > 0.0f) {
 
 			mandel.setMaxIterations(mandel.getMaxIterations() * 2);
 
 			// Compute Mandelbrot - update image data.
-			mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+			ComputeImage();
 		}
 		else {
 			// Scrolling in the opposite direction halves the
@@ -221,7 +487,7 @@ void InteractMandel::ControlIterations()
 			if (mandel.getMaxIterations() < 1) { mandel.setMaxIterations(1); }
 
 			// Compute Mandelbrot - update image data.
-			mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+			ComputeImage();
 		}
 	}
 	// *depends on a particular mouse's scroll direction.
@@ -229,49 +495,133 @@ void InteractMandel::ControlIterations()
 	// Reset to default iterations threshold.
 	if (input->isKeyDown(sf::Keyboard::Q)) {
 
+		autoIterations = false;
 		mandel.setMaxIterations(500);
 
 		// Compute Mandelbrot - update image data.
-		mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied);
+		ComputeImage();
 	}
 
 	// Computation struggles with such a sharp increase in max iterations.
 	// ONLY COMPUTE MANDELBROT WHEN REQUIRED.
 }
 
-void InteractMandel::Update(float frame_time)
+void InteractMandel::AnimateZoom(float frame_time)
 {
-	// Compute the mandelbrot image for the explicit purpose
-	//  of recording timing data.
+	if (!zoom.Step(frame_time, WIDTH, HEIGHT, left, right, top, bottom)) { return; }
 
-	if (sample < SAMPLE_SIZE) {
+	// Compute Mandelbrot - update image data. The frame which settles
+	// the zoom is a whole progressive frame.
+	ComputeImage();
+}
 
-		// Compute Mandelbrot - update performance data.
-		mandel.ComputeMandelbrot(left, right, top, bottom, blurApplied, sample);
+void InteractMandel::FollowJulia()
+{
+	if (!juliaPreview) { return; }
 
-		++sample;
+	// The point of the Mandelbrot view under the cursor is the Julia
+	// constant, mapped as TransformImage maps it.
+	double x = left + (right - left) * input->getMouseX() / WIDTH;
+	double y = bottom + (top - bottom) * input->getMouseY() / HEIGHT;
 
-		// Upon completion of sample timings,
-		// print raw results.
-		if (sample == SAMPLE_SIZE) {
+	juliaPreview->Follow(x, y);
+}
 
-			mandel.PrintResults();
+void InteractMandel::Update(float frame_time)
+{
+	// Spend this frame's budget on the view's unfinished tiles; less of
+	// it mid-zoom, when the frame is likely superseded by the next.
+	if (!mandel.ProgressiveComplete()) { ContinueProgressive(zoom.Active() ? ZOOM_FRAME_BUDGET_MS : FRAME_BUDGET_MS); }
+
+	if (previewVisible) {
+		if (mandel.ProgressiveComplete()) { previewVisible = false; }
+
+		// The tiles finished since last frame, and the pixels mirrored
+		// from them, are drawn over the preview.
+		for (; tilesShown < mandel.getTilesDone(); ++tilesShown) {
+			for (const sf::IntRect& rect : { mandel.getTileRect(tilesShown), mandel.getTileMirrorRect(tilesShown) }) {
+				if (rect.height == 0) { continue; }
+
+				const sf::FloatRect tile(rect);
+				const sf::Vector2f corners[4] = {
+					sf::Vector2f(tile.left, tile.top),
+					sf::Vector2f(tile.left + tile.width, tile.top),
+					sf::Vector2f(tile.left + tile.width, tile.top + tile.height),
+					sf::Vector2f(tile.left, tile.top + tile.height),
+				};
+				for (const sf::Vector2f& corner : corners) { tileQuads.append(sf::Vertex(corner, corner)); }
+			}
 		}
 	}
 
-
 	// Update texture from array of pixels.
-	mandelTexture.update(mandel.GetMandelPixels());
+	sf::Uint8* pixels;
+	{
+		ScopedPhase timed(frameTimer, Phase::REPACK);
+		pixels = mandel.GetMandelPixels();
+	}
+	{
+		ScopedPhase timed(frameTimer, Phase::UPLOAD);
+		TraceSpan span("texture upload", "upload");
+		mandelTexture.update(pixels);
+	}
 
 	// Assign texture to sprite (to draw).
 	mandelSprite.setTexture(mandelTexture);
+
+	// Show the preview's newest frame; quick frames are smaller, and
+	// are scaled up to fill the inset.
+	int size = 0;
+	if (juliaPreview && juliaPreview->TakeFrame(juliaPixels, size)) {
+		ScopedPhase timed(frameTimer, Phase::UPLOAD);
+
+		if (juliaTexture.getSize().x != (unsigned)size && !juliaTexture.create(size, size)) { return; }
+		juliaTexture.update(juliaPixels.data());
+
+		juliaSprite.setTexture(juliaTexture, true);
+		juliaSprite.setScale((float)JULIA_PREVIEW_SIZE / size, (float)JULIA_PREVIEW_SIZE / size);
+	}
+}
+
+void InteractMandel::DrawFrame(sf::RenderTarget& target)
+{
+	target.draw(mandelSprite);
+
+	// Until its tiles are done, the new frame is coarse pixels, then
+	// the last frame reprojected over them, then the tiles on top.
+	if (previewVisible) {
+		target.draw(previewSprite);
+		target.draw(tileQuads, &mandelTexture);
+	}
 }
 
 void InteractMandel::Render()
 {
-	// Render Mandelbrot and zoomWindow graphic.
-	window->draw(mandelSprite);
-	window->draw(zoomWindow);
+	{
+		ScopedPhase timed(frameTimer, Phase::DRAW);
+
+		// Render Mandelbrot and zoomWindow graphic.
+		DrawFrame(*window);
+		window->draw(zoomWindow);
+
+		if (juliaPreview) {
+			window->draw(juliaFrame);
+			if (juliaSprite.getTexture()) { window->draw(juliaSprite); }
+		}
+
+		if (overlayVisible && overlayFontLoaded) {
+			// Percentiles are refreshed a few times a second rather than every frame.
+			if (++overlayAge >= OVERLAY_REFRESH_FRAMES) {
+				overlayText.setString(frameTimer.Summary());
+				overlayAge = 0;
+			}
+			window->draw(overlayText);
+		}
+	}
+	{
+		ScopedPhase timed(frameTimer, Phase::DISPLAY);
+		window->display();
+	}
 
-	window->display();
+	frameTimer.EndFrame();
 }
\ No newline at end of file
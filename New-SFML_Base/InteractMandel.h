@@ -1,8 +1,29 @@
 #pragma once
 
-#include "AMPQuery.h"
+#include "Mandelbrot.h"
+#include "FrameTimer.h"
+#include "JuliaPreview.h"
+#include "Trace.h"
+#include "ZoomAnimation.h"
 #include "Framework/Input.h"  // (Robertson, P(2020) [1])
 
+// Fonts tried, in order, for the timing overlay.
+const char* const OVERLAY_FONTS[] = {
+	"font/consola.ttf",
+	"C:/Windows/Fonts/consola.ttf",
+	"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+};
+
+// Frames between refreshes of the overlay text.
+const int OVERLAY_REFRESH_FRAMES = 15;
+
+// Gap between the Julia inset and the window's top-right corner.
+const float JULIA_INSET_MARGIN = 8.0f;
+
+// Milliseconds of full-resolution tiles rendered each frame, while
+// progressive rendering is on.
+const double FRAME_BUDGET_MS = 12.0;
+
 class InteractMandel
 {
 private:
@@ -18,28 +39,89 @@ private:
 	sf::Texture mandelTexture;
 	sf::Sprite mandelSprite;
 
+	// The last frame shown, drawn transformed onto the new view while a
+	// progressive frame renders, under the tiles finished so far. Each
+	// preview is drawn from the one before, so they take turns.
+	sf::RenderTexture previewTargets[2];
+	int previewIndex;
+	sf::Sprite previewSprite;
+	sf::VertexArray tileQuads;
+	size_t tilesShown;
+	bool previewVisible;
+
 	// Zoom window shape and position data.
 	sf::RectangleShape zoomWindow;
 	sf::Vector2f zoomPosBegin;
 	sf::Vector2f dragPosPrev;
 
-	void ERZoomReset();
+	// Per-phase frame timings and the overlay showing them.
+	FrameTimer frameTimer;
+	sf::Font overlayFont;
+	sf::Text overlayText;
+	bool overlayFontLoaded;
+
+	// Julia set of the point under the cursor, while J mode is on.
+	std::unique_ptr<JuliaPreview> juliaPreview;
+	std::vector<uint8_t> juliaPixels;
+	sf::Texture juliaTexture;
+	sf::Sprite juliaSprite;
+	sf::RectangleShape juliaFrame;
+
+	// Recompute the image for the current view, timing each phase.
+	void ComputeImage();
+
+	// Render a progressive frame's tiles for up to budget milliseconds,
+	// or to the end, blurring once it is complete.
+	void ContinueProgressive(double budget);
+	void FinishProgressive();
+
+	// Keep the frame on screen as the new view's preview, if the view
+	// has moved since it was started. Returns whether the preview covers
+	// the whole of the new view.
+	bool StartPreview();
+
+	// Draw the image, and any preview and finished tiles over it.
+	void DrawFrame(sf::RenderTarget& target);
+
+	// Move the view by this frame's share of the wheel or key zoom.
+	void AnimateZoom(float frame_time);
+
+	void ERZoomReset(float frame_time);
 	void ComputeZoomWindow();
 	void DragViewWindow();
-	void TransformImage(float x, float y, float z);
+	void TransformImage(double x, double y, double z);
 	void ControlIterations();
+	void FollowJulia();
 
 	// Additional member variables.
 	bool leftMouseDrag;
 	bool middleMouseDrag;
 
-	float left, right;
-	float top, bottom;
+	// View on the complex plane, in double so that the double and
+	// double-double kernels can zoom past single precision.
+	double left, right;
+	double top, bottom;
 
-	int sample;
+	// The views of the frame in the image, and of the preview.
+	double frameLeft, frameRight, frameTop, frameBottom;
+	double previewLeft, previewRight, previewTop, previewBottom;
 
 	bool blurApplied;
 
+	// Wheel and R/E key zoom, still to be animated.
+	ZoomAnimation zoom;
+
+	// Whether each view picks its own iteration limit, until the wheel
+	// or Q sets one by hand.
+	bool autoIterations;
+
+	// Whether views are rendered a budget at a time, coarse first, so
+	// that frames keep their pace however costly the view.
+	bool progressive;
+
+	bool overlayVisible;
+	int overlayAge;
+
 public:
 	// Specified constructor and application core
 	// loop functions.
@@ -0,0 +1,165 @@
+#include "JuliaPreview.h"
+#include "Mandelbrot.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <cstring>
+
+// Import things we need from the standard library
+using std::chrono::steady_clock;
+
+
+JuliaPreview::JuliaPreview()
+	: juliaX(0.0),
+	juliaY(0.0),
+	generation(0),
+	refineWanted(false),
+	stopping(false),
+	lastMove(steady_clock::now()),
+	frameSize(0),
+	frameReady(false)
+{
+	thread = std::thread(&JuliaPreview::RenderLoop, this);
+}
+
+JuliaPreview::~JuliaPreview()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+}
+
+void JuliaPreview::Follow(double x, double y)
+{
+	const steady_clock::time_point now = steady_clock::now();
+	bool changed = false;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		if (x != juliaX || y != juliaY) {
+			juliaX = x;
+			juliaY = y;
+			++generation;
+			refineWanted = false;
+			lastMove = now;
+			changed = true;
+		}
+		else if (!refineWanted && now - lastMove >= JULIA_REFINE_DELAY) {
+			refineWanted = true;
+			changed = true;
+		}
+	}
+	if (changed) { wake.notify_one(); }
+}
+
+bool JuliaPreview::TakeFrame(std::vector<uint8_t>& rgba, int& size)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (!frameReady) { return false; }
+
+	rgba.swap(frame);
+	size = frameSize;
+	frameReady = false;
+	return true;
+}
+
+bool JuliaPreview::Current(unsigned tag)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return tag == generation && !stopping;
+}
+
+void JuliaPreview::Publish(unsigned tag, const uint8_t* rgba, int size)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (tag != generation) { return; }
+
+	frame.assign(rgba, rgba + size * size * 4);
+	frameSize = size;
+	frameReady = true;
+}
+
+void JuliaPreview::RenderLoop()
+{
+	Trace::NameThread("julia preview");
+
+	// Threads of the preview's own, so that neither it nor the main view
+	// waits for the other's turn on the shared pool. The shared pool is
+	// pinned across every processor, so these are left unpinned for the
+	// scheduler to place wherever the main view leaves time.
+	WorkerPool pool(WorkerPool::SharedTopology(), JULIA_PREVIEW_THREADS, false);
+
+	// Renderers for quick frames and for strips of refined ones, kept
+	// between frames so their buffers are allocated once.
+	Mandelbrot coarse(JULIA_COARSE_SIZE, JULIA_COARSE_SIZE);
+	coarse.setFormula(Formula::JULIA);
+	coarse.setMaxIterations(JULIA_COARSE_ITERATIONS);
+	coarse.setWorkerPool(&pool);
+
+	Mandelbrot strip(JULIA_PREVIEW_SIZE, JULIA_REFINE_ROWS);
+	strip.setFormula(Formula::JULIA);
+	strip.setMaxIterations(JULIA_FINE_ITERATIONS);
+	strip.setWorkerPool(&pool);
+
+	std::vector<uint8_t> fine(JULIA_PREVIEW_SIZE * JULIA_PREVIEW_SIZE * 4);
+
+	// Generations last rendered quickly and refined.
+	unsigned coarseDone = 0, fineDone = 0;
+
+	for (;;) {
+		unsigned tag;
+		double x, y;
+		bool refine;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [&] {
+				return stopping || generation != coarseDone || (refineWanted && fineDone != generation);
+			});
+			if (stopping) { return; }
+
+			tag = generation;
+			x = juliaX;
+			y = juliaY;
+			refine = tag == coarseDone;
+		}
+
+		if (!refine) {
+			TraceSpan span("julia coarse", "render");
+
+			coarse.setJulia(x, y);
+			coarse.ComputeView(0.0, 0.0, JULIA_VIEW_WIDTH);
+			Publish(tag, coarse.GetMandelPixels(), JULIA_COARSE_SIZE);
+			coarseDone = tag;
+			continue;
+		}
+
+		TraceSpan span("julia refine", "render");
+		strip.setJulia(x, y);
+
+		// Rows run from the bottom of the view, as in the viewer.
+		const double half = JULIA_VIEW_WIDTH / 2;
+		const int rowBytes = JULIA_PREVIEW_SIZE * 4;
+
+		bool complete = true;
+		for (int y0 = 0; y0 < JULIA_PREVIEW_SIZE; y0 += JULIA_REFINE_ROWS) {
+			// Drop the rest of the refinement once c has moved on.
+			if (!Current(tag)) {
+				complete = false;
+				break;
+			}
+
+			strip.ComputeMandelbrot(-half, half,
+				-half + JULIA_VIEW_WIDTH * (y0 + JULIA_REFINE_ROWS) / JULIA_PREVIEW_SIZE,
+				-half + JULIA_VIEW_WIDTH * y0 / JULIA_PREVIEW_SIZE);
+			std::memcpy(fine.data() + y0 * rowBytes, strip.GetMandelPixels(), JULIA_REFINE_ROWS * rowBytes);
+		}
+
+		if (complete) {
+			Publish(tag, fine.data(), JULIA_PREVIEW_SIZE);
+			fineDone = tag;
+		}
+	}
+}
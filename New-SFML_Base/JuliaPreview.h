@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Edge of the square Julia inset, in pixels, and of the quick frames
+// shown in it while the cursor is moving.
+const int JULIA_PREVIEW_SIZE = 256;
+const int JULIA_COARSE_SIZE = 64;
+
+// Iteration caps of the quick and refined frames.
+const int JULIA_COARSE_ITERATIONS = 64;
+const int JULIA_FINE_ITERATIONS = 500;
+
+// Rows of a refined frame rendered between checks for a newer c.
+const int JULIA_REFINE_ROWS = 32;
+
+// How long the cursor must rest before its frame is refined.
+const std::chrono::milliseconds JULIA_REFINE_DELAY(150);
+
+// Width of the Julia view on the complex plane, about the origin.
+const double JULIA_VIEW_WIDTH = 3.2;
+
+// Threads the preview renders on, apart from the viewer's; enough for
+// its small frames without taking much from the main view.
+const int JULIA_PREVIEW_THREADS = 2;
+
+
+// Renders the Julia set of a c that follows the cursor, on a thread of
+// its own so that the viewer's frame loop never waits for it.
+//
+// Each move of c is rendered first as a small, low-iteration frame;
+// once c has stayed put for JULIA_REFINE_DELAY it is rendered again at
+// full size, in strips. A render whose c has since moved is dropped:
+// a quick frame is not shown, and a refinement stops at its next strip.
+class JuliaPreview
+{
+private:
+	std::thread thread;
+
+	std::mutex lock;
+	std::condition_variable wake;
+
+	// The c to show. generation counts its changes, and tags renders,
+	// so that a render of an older c is never shown.
+	double juliaX, juliaY;
+	unsigned generation;
+	bool refineWanted;
+	bool stopping;
+
+	// When c last changed, for deciding to refine.
+	std::chrono::steady_clock::time_point lastMove;
+
+	// The newest finished frame, as RGBA, not yet taken by the viewer.
+	std::vector<uint8_t> frame;
+	int frameSize;
+	bool frameReady;
+
+	void RenderLoop();
+
+	// Whether the render tagged with generation is still wanted.
+	bool Current(unsigned tag);
+
+	// Hand a finished frame to the viewer, unless c has moved on.
+	void Publish(unsigned tag, const uint8_t* rgba, int size);
+
+public:
+	JuliaPreview();
+	~JuliaPreview();
+
+	// Show the Julia set of (x, y). Called every frame by the viewer;
+	// it only starts a render when c has changed, or has come to rest.
+	void Follow(double x, double y);
+
+	// Take the newest finished frame, if there is one since the last call.
+	bool TakeFrame(std::vector<uint8_t>& rgba, int& size);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+
+// N values of T worked on together. Every operator is a plain loop over
+// the lanes, which the compiler unrolls into vector instructions, so an
+// OwnComplex<LanePack<float, 8>> iterates eight pixels at once.
+template <typename T, int N>
+struct LanePack
+{
+	T v[N];
+
+	LanePack() restrict(cpu, amp)
+	{
+		for (int l = 0; l < N; ++l) { v[l] = T(0.0); }
+	}
+
+	// Every lane the same value.
+	LanePack(const T& value) restrict(cpu, amp)
+	{
+		for (int l = 0; l < N; ++l) { v[l] = value; }
+	}
+};
+
+// Per-lane result of a comparison; ints, as AMP has no bool arrays.
+template <int N>
+struct LaneMask
+{
+	int m[N];
+
+	bool Any() const restrict(cpu, amp)
+	{
+		int any = 0;
+		for (int l = 0; l < N; ++l) { any |= m[l]; }
+		return any != 0;
+	}
+};
+
+
+template <typename T, int N>
+inline LanePack<T, N> operator+(const LanePack<T, N>& a, const LanePack<T, N>& b) restrict(cpu, amp)
+{
+	LanePack<T, N> r;
+	for (int l = 0; l < N; ++l) { r.v[l] = a.v[l] + b.v[l]; }
+	return r;
+}
+
+template <typename T, int N>
+inline LanePack<T, N> operator-(const LanePack<T, N>& a, const LanePack<T, N>& b) restrict(cpu, amp)
+{
+	LanePack<T, N> r;
+	for (int l = 0; l < N; ++l) { r.v[l] = a.v[l] - b.v[l]; }
+	return r;
+}
+
+template <typename T, int N>
+inline LanePack<T, N> operator*(const LanePack<T, N>& a, const LanePack<T, N>& b) restrict(cpu, amp)
+{
+	LanePack<T, N> r;
+	for (int l = 0; l < N; ++l) { r.v[l] = a.v[l] * b.v[l]; }
+	return r;
+}
+
+template <typename T, int N>
+inline LaneMask<N> operator<(const LanePack<T, N>& a, const LanePack<T, N>& b) restrict(cpu, amp)
+{
+	LaneMask<N> r;
+	for (int l = 0; l < N; ++l) { r.m[l] = a.v[l] < b.v[l] ? 1 : 0; }
+	return r;
+}
+
+template <int N>
+inline LaneMask<N> operator&(const LaneMask<N>& a, const LaneMask<N>& b) restrict(cpu, amp)
+{
+	LaneMask<N> r;
+	for (int l = 0; l < N; ++l) { r.m[l] = a.m[l] & b.m[l]; }
+	return r;
+}
@@ -1,38 +1,59 @@
 #include "Mandelbrot.h"
+#include "DoubleDouble.h"
+#include "FixedPoint.h"
+#include "Formula.h"
+#include "LanePack.h"
 #include "OwnComplex.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <memory>
 
 
 
 // Import things we need from the standard library
-using std::chrono::duration_cast;
-using std::chrono::nanoseconds;
 using std::cout;
 using std::endl;
 using std::ofstream;
 
-// Define the alias "the_amp_clock" for the clock type we're going to use.
-typedef std::chrono::steady_clock the_amp_clock;
-
 // Need to access the concurrency libraries 
 using namespace concurrency;
 
 
-// The image data.
-// Each pixel is represented as 0xRRGGBB.
-uint32_t image[HEIGHT][WIDTH];
-
 // Size of separated filter dimension.
 const int KERNEL_SIZE = 7;
 
+Backend Mandelbrot::defaultBackend = Backend::AMP;
+Precision Mandelbrot::defaultPrecision = Precision::FLOAT;
+Formula Mandelbrot::defaultFormula = Formula::MANDELBROT;
+double Mandelbrot::defaultJuliaX = -0.8;
+double Mandelbrot::defaultJuliaY = 0.156;
+bool Mandelbrot::defaultDistanceEstimation = false;
+TuneConfig Mandelbrot::tuning;
+
+
+
+Mandelbrot::Mandelbrot(int width, int height)
+	: imageWidth(width),
+	imageHeight(height),
+	image(width * height),
+	counts(width * height),
+	pixels(width * height * 4)
+{
+}
 
 
-// Write the image to a TGA file with the given name.
+// Encode a colour buffer as an uncompressed TGA.
 // Format specification: http://www.gamers.org/dEngine/quake3/TGA.txt
-void Mandelbrot::WriteTga(const char* filename)
+void Mandelbrot::EncodeTga(const uint32_t* colours, int width, int height, std::vector<uint8_t>& tga)
 {
 	// (Sampson, A(2020) [3]) \\
 
-	ofstream outfile(filename, ofstream::binary);
+	TraceSpan span("encode tga", "encode");
 
 	uint8_t header[18] = {
 		0, // no image ID
@@ -41,158 +62,1504 @@ void Mandelbrot::WriteTga(const char* filename)
 		0, 0, 0, 0, 0, // empty colour map specification
 		0, 0, // X origin
 		0, 0, // Y origin
-		WIDTH & 0xFF, (WIDTH >> 8) & 0xFF, // width
-		HEIGHT & 0xFF, (HEIGHT >> 8) & 0xFF, // height
+		uint8_t(width & 0xFF), uint8_t((width >> 8) & 0xFF), // width
+		uint8_t(height & 0xFF), uint8_t((height >> 8) & 0xFF), // height
 		24, // bits per pixel
 		0, // image descriptor
 	};
-	outfile.write((const char*)header, 18);
+	tga.assign(header, header + 18);
+	tga.reserve(18 + width * height * 3);
 
-	for (int y = HEIGHT - 1; y > -1; --y)
+	for (int y = height - 1; y > -1; --y)
 	{
-		for (int x = 0; x < WIDTH; ++x)
+		for (int x = 0; x < width; ++x)
 		{
-			uint8_t pixel[3] = {
-				image[y][x] & 0xFF, // blue channel
-				(image[y][x] >> 8) & 0xFF, // green channel
-				(image[y][x] >> 16) & 0xFF, // red channel
-			};
-			outfile.write((const char*)pixel, 3);
+			const uint32_t colour = colours[y * width + x];
+
+			tga.push_back(colour & 0xFF); // blue channel
+			tga.push_back((colour >> 8) & 0xFF); // green channel
+			tga.push_back((colour >> 16) & 0xFF); // red channel
 		}
 	}
+}
+
+void Mandelbrot::EncodeTga(std::vector<uint8_t>& tga)
+{
+	EncodeTga(image.data(), imageWidth, imageHeight, tga);
+}
+
+// Write a colour buffer to a TGA file with the given name.
+bool Mandelbrot::WriteTga(const char* filename, const uint32_t* colours, int width, int height)
+{
+	std::vector<uint8_t> tga;
+	EncodeTga(colours, width, height, tga);
+
+	ofstream outfile(filename, ofstream::binary);
+	outfile.write((const char*)tga.data(), tga.size());
 
 	outfile.close();
 	if (!outfile)
 	{
 		// An error has occurred at some point since we opened the file.
 		cout << "Error writing to " << filename << endl;
-		exit(1);
+		return false;
+	}
+	return true;
+}
+
+bool Mandelbrot::WriteTga(const char* filename)
+{
+	return WriteTga(filename, image.data(), imageWidth, imageHeight);
+}
+
+
+void Mandelbrot::SetTile(int x, int y, int width, int height, const std::vector<uint32_t>& colours)
+{
+	// Tile rows are in the same order as image rows.
+	for (int row = 0; row < height; ++row) {
+		std::copy(colours.begin() + row * width, colours.begin() + (row + 1) * width,
+			image.begin() + (y + row) * imageWidth + x);
 	}
 }
 
 
 sf::Uint8* Mandelbrot::GetMandelPixels()
 {
+	TraceSpan span("repack", "encode");
+
 	// An independant counter for pixel;
 	int pIndex = 0;
 
-	for (int y = 0; y < HEIGHT; ++y)
+	for (const uint32_t colour : image)
 	{
-		for (int x = 0; x < WIDTH; ++x)
-		{
-			pixels[pIndex] = (image[y][x] >> 16) & 0xFF;	// red channel
-			pixels[pIndex + 1] = (image[y][x] >> 8) & 0xFF;	// green channel
-			pixels[pIndex + 2] = image[y][x] & 0xFF;		// blue channel
-			pixels[pIndex + 3] = 0xFF;						// alpha channel
+		pixels[pIndex] = (colour >> 16) & 0xFF;		// red channel
+		pixels[pIndex + 1] = (colour >> 8) & 0xFF;	// green channel
+		pixels[pIndex + 2] = colour & 0xFF;			// blue channel
+		pixels[pIndex + 3] = 0xFF;					// alpha channel
 
-			pIndex += 4;
-		}
+		pIndex += 4;
 	}
-	/*sf::Uint8* sfpixels = pixels;
-	return sfpixels;*/
 
-	return pixels;
+	return pixels.data();
+}
+
+
+// The point on the complex plane of pixel i of size, between low and high.
+template <typename T>
+inline T MapPixel(T low, T high, unsigned int i, int size) restrict(cpu, amp)
+{
+	return low + (i * (high - low) / size);
+}
+
+// Double-double has no division; the pixel's fraction of the span is
+// exact enough in double, as its error is far below a pixel.
+inline DoubleDouble MapPixel(DoubleDouble low, DoubleDouble high, unsigned int i, int size) restrict(cpu, amp)
+{
+	return low + (high - low) * DoubleDouble((double)i / size);
+}
+
+// Nor has fixed point, which takes the fraction the same way.
+template <int N>
+inline Fixed<N> MapPixel(Fixed<N> low, Fixed<N> high, unsigned int i, int size) restrict(cpu, amp)
+{
+	return low + (high - low) * Fixed<N>((double)i / size);
+}
+
+// Iterate the formula F from its start for the point (px, py) until z
+// moves more than 2 units away from (0, 0), or we've iterated too many
+// times [3]. k is the formula's parameter.
+// Shared by the AMP and CPU kernels so that both give the same image.
+// known is set when the point skipped iteration as a known interior one.
+template <typename F, typename T>
+inline unsigned int EscapeIterations(T px, T py, T kx, T ky, unsigned int maxIterations, bool& known) restrict(cpu, amp)
+{
+	// Skip straight to the limit for points known to be in the set.
+	known = F::KnownInterior(px, py);
+	if (known) { return maxIterations; }
+
+	OwnComplex<T> z, c;
+	F::Start(OwnComplex<T>(px, py), OwnComplex<T>(kx, ky), z, c);
+
+	// |z| < 2 without the square root.
+	const T bailout(4.0);
+
+	unsigned int iterations = 0;
+	while (z.SquaredMagnitude() < bailout && iterations < maxIterations)
+	{
+		F::Step(z, c);
+
+		++iterations;
+	}
+	return iterations;
+}
+
+template <typename F, typename T>
+inline unsigned int EscapeIterations(T px, T py, T kx, T ky, unsigned int maxIterations) restrict(cpu, amp)
+{
+	bool known;
+	return EscapeIterations<F>(px, py, kx, ky, maxIterations, known);
+}
+
+// Colour a pixel from its escape iteration count.
+inline uint32_t IterationColour(unsigned int iterations, unsigned int maxIterations) restrict(cpu, amp)
+{
+	if (iterations == maxIterations)
+	{
+		// z didn't escape from the circle.
+		// This point is in the Mandelbrot set.
+		return 0x000000; // Black.
+	}
+
+	// z escaped within less than maxIterations
+	// iterations. This point isn't in the set.
+
+	// Make up a greyscale value performing bitwise operations on 'iterations.'
+	return ((iterations << 16) | (iterations << 8) | iterations);
+}
+
+
+// |z|^2 at which distance estimation stops iterating. Far beyond the
+// escape-time bailout, as the estimate is only accurate for large |z|.
+const float DISTANCE_BAILOUT = 1.0e6f;
+
+// Distance from the set, in pixels, over which shading fades to white.
+const float DISTANCE_FADE_PIXELS = 4.0f;
+
+// Narrow a kernel scalar to float, saturating at +/-FLT_MAX. The range
+// is tested in the scalar's own type, as narrowing a value float cannot
+// hold is undefined; NaN saturates high, so it fails a < FLT_MAX test.
+template <typename T>
+inline float ToFloat(const T& x) restrict(cpu, amp)
+{
+	if (!(x < T(FLT_MAX))) { return FLT_MAX; }
+	if (!(x > T(-FLT_MAX))) { return -FLT_MAX; }
+	return (float)x;
+}
+
+inline float ToFloat(const DoubleDouble& x) restrict(cpu, amp)
+{
+	return ToFloat(x.hi);
+}
+
+template <int N>
+inline float ToFloat(const Fixed<N>& x) restrict(cpu, amp)
+{
+	return ToFloat(x.ToDouble());
+}
+
+// Exterior distance |z| ln|z| / |dz|, from |z|^2 and |dz|^2. The maths
+// functions differ on the accelerator, hence the two restrictions.
+inline float DistanceFrom(float zz, float dd) restrict(cpu)
+{
+	return 0.5f * std::sqrt(zz / dd) * std::log(zz);
+}
+
+inline float DistanceFrom(float zz, float dd) restrict(amp)
+{
+	return 0.5f * fast_math::sqrt(zz / dd) * fast_math::log(zz);
+}
+
+// Iterate as EscapeIterations does, carrying dz alongside z, and
+// estimate the distance from the point to the set once it escapes.
+// Points which don't escape get a distance of zero.
+template <typename F, typename T>
+inline unsigned int EscapeDistance(T px, T py, T kx, T ky, unsigned int maxIterations, float& distance, bool& known) restrict(cpu, amp)
+{
+	distance = 0.0f;
+	known = F::KnownInterior(px, py);
+	if (known) { return maxIterations; }
+
+	OwnComplex<T> z, c, dz;
+	F::Start(OwnComplex<T>(px, py), OwnComplex<T>(kx, ky), z, c);
+	F::StartDerivative(dz);
+
+	const T bailout(DISTANCE_BAILOUT);
+
+	unsigned int iterations = 0;
+	while (z.SquaredMagnitude() < bailout && iterations < maxIterations)
+	{
+		// dz is updated from z before the step.
+		F::Derivative(dz, z);
+		F::Step(z, c);
+
+		++iterations;
+	}
+
+	// dz can overflow before z escapes, right against the boundary; such
+	// points saturate to FLT_MAX and are left at a distance of zero.
+	const float dd = ToFloat(dz.SquaredMagnitude());
+	if (iterations < maxIterations && dd < FLT_MAX) {
+		distance = DistanceFrom(ToFloat(z.SquaredMagnitude()), dd);
+	}
+	return iterations;
+}
+
+template <typename F, typename T>
+inline unsigned int EscapeDistance(T px, T py, T kx, T ky, unsigned int maxIterations, float& distance) restrict(cpu, amp)
+{
+	bool known;
+	return EscapeDistance<F>(px, py, kx, ky, maxIterations, distance, known);
+}
+
+// Colour a pixel by its distance from the set: black within the set and
+// on its boundary, fading to white DISTANCE_FADE_PIXELS pixels away, so
+// filaments narrower than a pixel are still drawn.
+inline uint32_t DistanceColour(float distance, unsigned int iterations, unsigned int maxIterations, float spacing) restrict(cpu, amp)
+{
+	if (iterations == maxIterations) { return 0x000000; }
+
+	float t = distance / (DISTANCE_FADE_PIXELS * spacing);
+	t = t < 1.0f ? t : 1.0f;
+
+	uint32_t grey = (uint32_t)(255.0f * t * (2.0f - t));
+	return (grey << 16) | (grey << 8) | grey;
 }
 
 
 // Render the Mandelbrot set into the image array [3].
 // The parameters specify the region on the complex plane to plot.
 
-void Mandelbrot::ComputeMandelbrot(float left, float right, float top, float bottom, bool blur, int sample)
+const char* Mandelbrot::BackendName(Backend backend)
+{
+	return backend == Backend::CPU ? "cpu" : "amp";
+}
+
+const char* Mandelbrot::PrecisionName(Precision precision)
+{
+	switch (precision) {
+	case Precision::DOUBLE: return "double";
+	case Precision::DOUBLE_DOUBLE: return "double-double";
+	case Precision::FIXED64: return "fixed64";
+	case Precision::FIXED128: return "fixed128";
+	default: return "float";
+	}
+}
+
+bool Mandelbrot::ParsePrecision(const std::string& name, Precision& precision)
+{
+	// dd is short for double-double.
+	if (name == "dd") {
+		precision = Precision::DOUBLE_DOUBLE;
+		return true;
+	}
+
+	for (Precision p : { Precision::FLOAT, Precision::DOUBLE, Precision::DOUBLE_DOUBLE, Precision::FIXED64, Precision::FIXED128 }) {
+		if (name == PrecisionName(p)) {
+			precision = p;
+			return true;
+		}
+	}
+	return false;
+}
+
+Precision Mandelbrot::KernelPrecision() const
+{
+	if (!distanceEstimation || (precision != Precision::FIXED64 && precision != Precision::FIXED128)) {
+		return precision;
+	}
+
+	static bool warned = false;
+	if (!warned) {
+		cout << "Distance estimation needs more range than fixed point; iterating in double" << endl;
+		warned = true;
+	}
+	return Precision::DOUBLE;
+}
+
+const char* Mandelbrot::FormulaName(Formula formula)
 {
-	// Local pointer to the globally declared image data.
-	uint32_t* pImage = &(image[0][0]);
+	switch (formula) {
+	case Formula::JULIA: return "julia";
+	case Formula::MULTIBROT3: return "multibrot3";
+	case Formula::MULTIBROT4: return "multibrot4";
+	case Formula::BURNING_SHIP: return "burningship";
+	default: return "mandelbrot";
+	}
+}
+
+bool Mandelbrot::ParseFormula(const std::string& name, Formula& formula)
+{
+	for (Formula f : { Formula::MANDELBROT, Formula::JULIA, Formula::MULTIBROT3, Formula::MULTIBROT4, Formula::BURNING_SHIP }) {
+		if (name == FormulaName(f)) {
+			formula = f;
+			return true;
+		}
+	}
+	return false;
+}
+
+void Mandelbrot::ComputeMandelbrot(double left, double right, double top, double bottom, bool blur)
+{
+	ComputeBounds(left, right, top, bottom, blur);
+}
+
+void Mandelbrot::ComputeBounds(const DoubleDouble& left, const DoubleDouble& right,
+	const DoubleDouble& top, const DoubleDouble& bottom, bool blur)
+{
+	viewLeft = left; viewRight = right;
+	viewTop = top; viewBottom = bottom;
+	lastMaxIterations = MAX_ITERATIONS;
+	kernelError.clear();
+	shortcutRows.assign((size_t)imageHeight * getStatsTilesX(), 0);
+
+	// A whole frame supersedes any progressive one under way.
+	tileOrder.clear();
+	nextTile = 0;
+
+	// The distance field is only allocated once it is asked for.
+	if (distanceEstimation && distances.size() != image.size()) {
+		distances.resize(image.size());
+	}
+
+	FindMirror(top, bottom);
+	computeRect = sf::IntRect(0, rowBegin, imageWidth, rowEnd - rowBegin);
+
+	if (backend == Backend::CPU) {
+		ComputeCPU(left, right, top, bottom);
+	}
+	else {
+		ComputeAMP(left, right, top, bottom);
+	}
+
+	MirrorRows(rowBegin, rowEnd, 0, imageWidth);
+
+	// If necessary, apply blur.
+	if (blur) { ApplyBlur(); }
+}
+
+WorkerPool& Mandelbrot::Pool() const
+{
+	return workerPool ? *workerPool : WorkerPool::Shared();
+}
+
+void Mandelbrot::KernelFailed(const char* what)
+{
+	kernelError = what;
+	if (errorDialogs) { MessageBoxA(NULL, what, "Error", MB_ICONERROR); }
+}
+
+bool Mandelbrot::MirrorSymmetric() const
+{
+	switch (formula) {
+	case Formula::BURNING_SHIP: return false;
+	case Formula::JULIA: return juliaY == 0.0;
+	default: return true;
+	}
+}
+
+void Mandelbrot::FindMirror(const DoubleDouble& top, const DoubleDouble& bottom)
+{
+	rowBegin = 0; rowEnd = imageHeight;
+	mirrorAxis = mirrorBegin = mirrorEnd = 0;
+
+	if (!MirrorSymmetric()) { return; }
+
+	// Row y is at bottom + y * span / height, so its reflection is at row
+	// axis - y, for axis = -2 bottom height / span: the axis is row axis / 2.
+	const double span = (top - bottom).hi;
+	const double axis = -2.0 * (bottom.hi + bottom.lo) * imageHeight / span;
+	const double nearest = std::floor(axis + 0.5);
+
+	if (std::abs(axis - nearest) > MIRROR_ALIGNMENT) { return; }
+
+	// Either side of the axis must hold a row whose reflection is another.
+	mirrorAxis = (int)nearest;
+	if (mirrorAxis < 1 || mirrorAxis > 2 * imageHeight - 3) { return; }
+
+	// Compute the side of the axis with more rows, axis row included,
+	// and mirror the rest of the other side from it.
+	if (mirrorAxis <= imageHeight - 1) {
+		rowBegin = (mirrorAxis + 1) / 2;
+		mirrorBegin = 0; mirrorEnd = rowBegin;
+	}
+	else {
+		rowEnd = mirrorAxis / 2 + 1;
+		mirrorBegin = rowEnd; mirrorEnd = imageHeight;
+	}
+}
+
+void Mandelbrot::MirrorRows(int y0, int y1, int x0, int x1)
+{
+	for (int y = y0; y < y1; ++y) {
+		const int to = mirrorAxis - y;
+		if (to < mirrorBegin || to >= mirrorEnd) { continue; }
+
+		const int from = y * imageWidth, into = to * imageWidth;
+		std::copy(image.begin() + from + x0, image.begin() + from + x1, image.begin() + into + x0);
+		std::copy(counts.begin() + from + x0, counts.begin() + from + x1, counts.begin() + into + x0);
+		if (distanceEstimation) {
+			std::copy(distances.begin() + from + x0, distances.begin() + from + x1, distances.begin() + into + x0);
+		}
+	}
+}
+
+void Mandelbrot::AlignToAxis(double& top, double& bottom) const
+{
+	if (!MirrorSymmetric()) { return; }
+
+	const double span = top - bottom;
+	const double axis = -2.0 * bottom * imageHeight / span;
+	const double nearest = std::floor(axis + 0.5);
+	if (nearest < 1.0 || nearest > 2.0 * imageHeight - 3.0 || std::abs(axis - nearest) <= MIRROR_ALIGNMENT) { return; }
+
+	// Put the axis on the nearest row, or halfway between two.
+	bottom = -nearest * span / (2.0 * imageHeight);
+	top = bottom + span;
+}
+
+// The AMP kernel for one formula, precision and tile size. The size is
+// a template parameter of the tiled extent, so every size the tuner may
+// choose is compiled here. s counts each row's shortcut pixels per
+// STATS_TILE columns.
+template <typename F, typename T, int TS>
+void DispatchTiles(array_view<uint32_t, 2> a, array_view<uint32_t, 2> n, array_view<uint32_t, 2> s,
+	T left, T right, T top, T bottom, T kx, T ky, int width, int height, int firstRow, int firstColumn, unsigned int maxIterations)
+{
+	// Pad the extent so that image dimensions need not be multiples of TS.
+	parallel_for_each(a.extent.tile<TS, TS>().pad(), [=](tiled_index<TS, TS> t_idx) restrict(amp) {
+		// Compute Mandelbrot here i.e. Mandelbrot kernel/shader...
+
+		// Threads in the padding have no pixel to write.
+		if (!a.extent.contains(t_idx.global)) { return; }
+
+		// USE THREAD ID/INDEX TO MAP INTO THE COMPLEX PLANE.
+		// The views hold the pixels from (firstColumn, firstRow) on.
+		unsigned int y = t_idx.global[0] + firstRow;
+		unsigned int x = t_idx.global[1] + firstColumn;
+
+		// Work out the point in the complex plane that
+		// corresponds to this pixel in the output image.
+		bool known;
+		unsigned int iterations = EscapeIterations<F>(
+			MapPixel(left, right, x, width),
+			MapPixel(bottom, top, y, height),
+			kx, ky, maxIterations, known);
+
+		if (known) { atomic_fetch_add(&s(t_idx.global[0], x / STATS_TILE), 1u); }
+
+		n[t_idx] = iterations;
+		a[t_idx] = IterationColour(iterations, maxIterations);
+	});
+}
+
+// As DispatchTiles, estimating each pixel's distance from the set.
+template <typename F, typename T, int TS>
+void DispatchDistanceTiles(array_view<uint32_t, 2> a, array_view<uint32_t, 2> n, array_view<float, 2> d, array_view<uint32_t, 2> s,
+	T left, T right, T top, T bottom, T kx, T ky, float spacing, int width, int height, int firstRow, int firstColumn, unsigned int maxIterations)
+{
+	parallel_for_each(a.extent.tile<TS, TS>().pad(), [=](tiled_index<TS, TS> t_idx) restrict(amp) {
+		if (!a.extent.contains(t_idx.global)) { return; }
+
+		unsigned int y = t_idx.global[0] + firstRow;
+		unsigned int x = t_idx.global[1] + firstColumn;
+
+		float distance;
+		bool known;
+		unsigned int iterations = EscapeDistance<F>(
+			MapPixel(left, right, x, width),
+			MapPixel(bottom, top, y, height),
+			kx, ky, maxIterations, distance, known);
+
+		if (known) { atomic_fetch_add(&s(t_idx.global[0], x / STATS_TILE), 1u); }
+
+		n[t_idx] = iterations;
+		d[t_idx] = distance;
+		a[t_idx] = DistanceColour(distance, iterations, maxIterations, spacing);
+	});
+}
+
+// LANES neighbouring pixels of a row, iterated together as one
+// OwnComplex of lane packs. Per pixel the arithmetic is that of
+// EscapeIterations, in the same order, so the image doesn't depend on
+// the lane count.
+template <typename F, typename T, int LANES>
+void EscapeLanes(T left, T right, T py, T kx, T ky, int width, int firstColumn, int columns, unsigned int maxIterations,
+	uint32_t* counts, uint32_t* colours, uint32_t* shortcuts)
+{
+	typedef LanePack<T, LANES> Pack;
+
+	for (int x0 = 0; x0 < columns; x0 += LANES) {
+		const int count = std::min(LANES, columns - x0);
+
+		Pack px;
+		LaneMask<LANES> active;
+		unsigned int n[LANES];
+
+		for (int l = 0; l < LANES; ++l) {
+			px.v[l] = MapPixel(left, right, firstColumn + x0 + l, width);
+
+			// Lanes past the end of the row, and points known to be in
+			// the set, never iterate.
+			bool inSet = l < count && F::KnownInterior(px.v[l], py);
+			n[l] = inSet ? maxIterations : 0;
+			active.m[l] = l < count && !inSet;
+			if (inSet) { ++shortcuts[(firstColumn + x0 + l) / STATS_TILE]; }
+		}
+
+		OwnComplex<Pack> z, c;
+		F::Start(OwnComplex<Pack>(px, Pack(py)), OwnComplex<Pack>(Pack(kx), Pack(ky)), z, c);
+		const Pack bailout(T(4.0));
+
+		for (unsigned int i = 0; i < maxIterations; ++i) {
+			const LaneMask<LANES> still = active & (z.SquaredMagnitude() < bailout);
+			if (!still.Any()) { break; }
+
+			// Finished lanes iterate on too, as branching per lane costs
+			// more; they are masked out of the count, and never rejoin.
+			F::Step(z, c);
+
+			for (int l = 0; l < LANES; ++l) { n[l] += still.m[l]; }
+			active = still;
+		}
+
+		for (int l = 0; l < count; ++l) {
+			counts[x0 + l] = n[l];
+			colours[x0 + l] = IterationColour(n[l], maxIterations);
+		}
+	}
+}
+
+// Columns [firstColumn, firstColumn + columns) of a row of the CPU
+// kernel, at the tuned lane count. counts and colours start at the
+// first; shortcuts, the row's shortcut pixels per STATS_TILE columns, at
+// the row's start.
+template <typename F, typename T>
+void EscapeRow(int lanes, T left, T right, T py, T kx, T ky, int width, int firstColumn, int columns, unsigned int maxIterations,
+	uint32_t* counts, uint32_t* colours, uint32_t* shortcuts)
+{
+	switch (lanes) {
+	case 16: EscapeLanes<F, T, 16>(left, right, py, kx, ky, width, firstColumn, columns, maxIterations, counts, colours, shortcuts); break;
+	case 8: EscapeLanes<F, T, 8>(left, right, py, kx, ky, width, firstColumn, columns, maxIterations, counts, colours, shortcuts); break;
+	case 4: EscapeLanes<F, T, 4>(left, right, py, kx, ky, width, firstColumn, columns, maxIterations, counts, colours, shortcuts); break;
+	default:
+		for (int x = 0; x < columns; ++x) {
+			bool known;
+			unsigned int iterations = EscapeIterations<F>(MapPixel(left, right, firstColumn + x, width), py, kx, ky, maxIterations, known);
+			if (known) { ++shortcuts[(firstColumn + x) / STATS_TILE]; }
+
+			counts[x] = iterations;
+			colours[x] = IterationColour(iterations, maxIterations);
+		}
+		break;
+	}
+}
+
+// One row of the distance-estimating CPU kernel. This is always scalar,
+// as each lane would need its z and dz kept from the iteration it escaped.
+template <typename F, typename T>
+void DistanceRow(T left, T right, T py, T kx, T ky, float spacing, int width, int firstColumn, int columns, unsigned int maxIterations,
+	uint32_t* counts, uint32_t* colours, float* distances, uint32_t* shortcuts)
+{
+	for (int x = 0; x < columns; ++x) {
+		float distance;
+		bool known;
+		unsigned int iterations = EscapeDistance<F>(MapPixel(left, right, firstColumn + x, width), py, kx, ky, maxIterations, distance, known);
+		if (known) { ++shortcuts[(firstColumn + x) / STATS_TILE]; }
+
+		counts[x] = iterations;
+		distances[x] = distance;
+		colours[x] = DistanceColour(distance, iterations, maxIterations, spacing);
+	}
+}
+
+void Mandelbrot::ComputeAMP(const DoubleDouble& left, const DoubleDouble& right, const DoubleDouble& top, const DoubleDouble& bottom)
+{
+	const Precision use = KernelPrecision();
+
+	switch (use) {
+	case Precision::DOUBLE:
+	case Precision::DOUBLE_DOUBLE:
+	case Precision::FIXED64:
+	case Precision::FIXED128:
+		// Limited double support lacks the division the pixel mapping
+		// needs, and the conversions fixed point is built from.
+		if (!accelerator().supports_double_precision) {
+			static bool warned = false;
+			if (!warned) {
+				cout << "Accelerator lacks double precision; rendering with the CPU backend" << endl;
+				warned = true;
+			}
+			ComputeCPU(left, right, top, bottom);
+		}
+		else if (use == Precision::DOUBLE) {
+			ComputeAMPAs<double>(left.hi, right.hi, top.hi, bottom.hi);
+		}
+		else if (use == Precision::FIXED64) {
+			ComputeAMPAs<Fixed64>(left, right, top, bottom);
+		}
+		else if (use == Precision::FIXED128) {
+			ComputeAMPAs<Fixed128>(left, right, top, bottom);
+		}
+		else {
+			ComputeAMPAs<DoubleDouble>(left, right, top, bottom);
+		}
+		break;
+	default:
+		ComputeAMPAs<float>((float)left.hi, (float)right.hi, (float)top.hi, (float)bottom.hi);
+		break;
+	}
+}
+
+// Bounds narrow to the kernel's precision through the high part, which
+// is the double the bounds would have been computed as. Fixed point
+// takes both parts, as 128 bits hold more than a double.
+void Mandelbrot::ComputeCPU(const DoubleDouble& left, const DoubleDouble& right, const DoubleDouble& top, const DoubleDouble& bottom)
+{
+	switch (KernelPrecision()) {
+	case Precision::DOUBLE: ComputeCPUAs<double>(left.hi, right.hi, top.hi, bottom.hi); break;
+	case Precision::DOUBLE_DOUBLE: ComputeCPUAs<DoubleDouble>(left, right, top, bottom); break;
+	case Precision::FIXED64: ComputeCPUAs<Fixed64>(left, right, top, bottom); break;
+	case Precision::FIXED128: ComputeCPUAs<Fixed128>(left, right, top, bottom); break;
+	default: ComputeCPUAs<float>((float)left.hi, (float)right.hi, (float)top.hi, (float)bottom.hi); break;
+	}
+}
+
+// Pick the kernel instance for this instance's formula. From here down
+// the formula is a template parameter, so the loop itself never switches.
+template <typename T>
+void Mandelbrot::ComputeAMPAs(T left, T right, T top, T bottom)
+{
+	switch (formula) {
+	case Formula::JULIA: ComputeAMPWith<JuliaStep>(left, right, top, bottom); break;
+	case Formula::MULTIBROT3: ComputeAMPWith<MultibrotStep<3>>(left, right, top, bottom); break;
+	case Formula::MULTIBROT4: ComputeAMPWith<MultibrotStep<4>>(left, right, top, bottom); break;
+	case Formula::BURNING_SHIP: ComputeAMPWith<BurningShipStep>(left, right, top, bottom); break;
+	default: ComputeAMPWith<MandelbrotStep>(left, right, top, bottom); break;
+	}
+}
+
+template <typename T>
+void Mandelbrot::ComputeCPUAs(T left, T right, T top, T bottom)
+{
+	switch (formula) {
+	case Formula::JULIA: ComputeCPUWith<JuliaStep>(left, right, top, bottom); break;
+	case Formula::MULTIBROT3: ComputeCPUWith<MultibrotStep<3>>(left, right, top, bottom); break;
+	case Formula::MULTIBROT4: ComputeCPUWith<MultibrotStep<4>>(left, right, top, bottom); break;
+	case Formula::BURNING_SHIP: ComputeCPUWith<BurningShipStep>(left, right, top, bottom); break;
+	default: ComputeCPUWith<MandelbrotStep>(left, right, top, bottom); break;
+	}
+}
+
+template <typename F, typename T>
+void Mandelbrot::ComputeAMPWith(T left, T right, T top, T bottom)
+{
+	// Local pointer to this instance's image data, from the first row
+	// to compute.
+	const int firstRow = computeRect.top;
+	const int firstColumn = computeRect.left;
+	uint32_t* pImage = image.data() + firstRow * imageWidth;
+
+	// Local copies, for restricted use, of the image dimensions.
+	const int width = imageWidth;
+	const int height = imageHeight;
 
 	// array_view object will permit the image data to be available
-	// on the CPU and GPU when needed.
-	extent<2> aex(HEIGHT, WIDTH);
-	array_view<uint32_t, 2> a(aex, pImage);
+	// on the CPU and GPU when needed. The views are sections of the rows
+	// to compute, so mirrored rows, and pixels outside a tile, are left out.
+	const extent<2> rows(computeRect.height, width);
+	const index<2> origin(0, firstColumn);
+	const extent<2> aex(computeRect.height, computeRect.width);
+	array_view<uint32_t, 2> a = array_view<uint32_t, 2>(rows, pImage).section(origin, aex);
+
+	// Iteration counts are written alongside the colours.
+	array_view<uint32_t, 2> n = array_view<uint32_t, 2>(rows, counts.data() + firstRow * width).section(origin, aex);
+
+	// Shortcut tallies are added to, as tiles of a progressive frame
+	// share them, so these are copied in rather than discarded.
+	const int statsTilesX = getStatsTilesX();
+	array_view<uint32_t, 2> s(computeRect.height, statsTilesX, shortcutRows.data() + firstRow * statsTilesX);
 
 	// Don't need to transfer data from CPU to GPU as all
 	// calculations are done on the GPU.
 	a.discard_data();
+	n.discard_data();
 
 
 	// Local copy, for restricted use, of MAX_ITERATIONS.
 	unsigned int maxIterations = MAX_ITERATIONS;
 
-	// Define the tile size.
-	const int TS = 8; // 32
+	// The Julia constant, in the kernel's precision.
+	const T kx(juliaX), ky(juliaY);
 
+	const float spacing = (float)getPixelSpacing();
 
-	// start clock for GPU version after array allocation
-	the_amp_clock::time_point start = the_amp_clock::now();
+
+	// The accelerator reports no per-tile timing, so the dispatch is one span.
+	TraceSpan span("amp dispatch", "render");
 
 	// It is wise to use exception handling here - AMP can fail for many reasons
 	// and it useful to know why (e.g. using double precision when there is limited or no support).
 	try
 	{
-		parallel_for_each(a.extent.tile<TS, TS>(), [=](tiled_index<TS, TS> t_idx) restrict(amp) {
-			// Compute Mandelbrot here i.e. Mandelbrot kernel/shader...
-
-			// USE THREAD ID/INDEX TO MAP INTO THE COMPLEX PLANE.
-			unsigned int y = t_idx.global[0];
-			unsigned int x = t_idx.global[1];
-
-			// Work out the point in the complex plane that
-			// corresponds to this pixel in the output image.
-			OwnComplex c;
-			c.SetXY(
-				left + (x * (right - left) / WIDTH),
-				bottom + (y * (top - bottom) / HEIGHT)
-			);
-
-			// Start off z at (0, 0).
-			OwnComplex z;
-
-			// Iterate z = z^2 + c until z moves more than 2 units
-			// away from (0, 0), or we've iterated too many times.
-			unsigned int iterations = 0;
-			while (z.Absolute() < 2.0 && iterations < maxIterations)
-			{
-				z.Multiply(z);
-				z.Add(c);
-
-				++iterations;
-			}
-
-			if (iterations == maxIterations)
-			{
-				// z didn't escape from the circle.
-				// This point is in the Mandelbrot set.
-				a[t_idx] = 0x000000; // Black.
+		if (distanceEstimation) {
+			array_view<float, 2> d = array_view<float, 2>(rows, distances.data() + firstRow * width).section(origin, aex);
+			d.discard_data();
+
+			switch (tuning.ampTileSize) {
+			case 32: DispatchDistanceTiles<F, T, 32>(a, n, d, s, left, right, top, bottom, kx, ky, spacing, width, height, firstRow, firstColumn, maxIterations); break;
+			case 16: DispatchDistanceTiles<F, T, 16>(a, n, d, s, left, right, top, bottom, kx, ky, spacing, width, height, firstRow, firstColumn, maxIterations); break;
+			default: DispatchDistanceTiles<F, T, 8>(a, n, d, s, left, right, top, bottom, kx, ky, spacing, width, height, firstRow, firstColumn, maxIterations); break;
 			}
-			else
-			{
-				// z escaped within less than maxIterations
-				// iterations. This point isn't in the set.
-
-				// Make up a greyscale value performing bitwise operations on 'iterations.'
-				a[t_idx] = ((iterations << 16) | (iterations << 8) | iterations);
+			d.synchronize();
+		}
+		else {
+			switch (tuning.ampTileSize) {
+			case 32: DispatchTiles<F, T, 32>(a, n, s, left, right, top, bottom, kx, ky, width, height, firstRow, firstColumn, maxIterations); break;
+			case 16: DispatchTiles<F, T, 16>(a, n, s, left, right, top, bottom, kx, ky, width, height, firstRow, firstColumn, maxIterations); break;
+			default: DispatchTiles<F, T, 8>(a, n, s, left, right, top, bottom, kx, ky, width, height, firstRow, firstColumn, maxIterations); break;
 			}
-		});
+		}
 		a.synchronize();
+		n.synchronize();
+		s.synchronize();
 	}
 	catch (const Concurrency::runtime_exception& ex)
 	{
-		MessageBoxA(NULL, ex.what(), "Error", MB_ICONERROR);
+		KernelFailed(ex.what());
+	}
+}
+
+template <typename F, typename T>
+void Mandelbrot::ComputeCPUWith(T left, T right, T top, T bottom)
+{
+	WorkerPool& pool = Pool();
+	const int workers = tuning.cpuThreads > 0
+		? std::min(tuning.cpuThreads, pool.getWorkerCount()) : pool.getWorkerCount();
+	const int stripRows = std::max(1, tuning.cpuStripRows);
+	const int lanes = tuning.simdLanes;
+
+	const int width = imageWidth;
+	const int height = imageHeight;
+	const unsigned int maxIterations = MAX_ITERATIONS;
+	const T kx(juliaX), ky(juliaY);
+
+	const bool distance = distanceEstimation;
+	const float spacing = (float)getPixelSpacing();
+
+	uint32_t* pImage = image.data();
+	uint32_t* pCounts = counts.data();
+	float* pDistances = distances.data();
+	uint32_t* pShortcuts = shortcutRows.data();
+	const int statsTilesX = getStatsTilesX();
+
+	// Worker w owns band w of the rows to compute, [first + w * rows / workers, first + (w + 1) * rows / workers),
+	// so the pages it writes are first touched, and so placed, on its own NUMA node.
+	// Each band hands out strips of rows from its own counter.
+	const int first = computeRect.top;
+	const int rows = computeRect.height;
+	const int firstColumn = computeRect.left;
+	const int columns = computeRect.width;
+	std::unique_ptr<std::atomic<int>[]> nextRow(new std::atomic<int>[workers]);
+	for (int band = 0; band < workers; ++band) {
+		nextRow[band] = first + band * rows / workers;
+	}
+
+	pool.Run([&](int worker) {
+		// Workers beyond the tuned count sit this frame out.
+		if (worker >= workers) { return; }
+
+		// Finish our own band, then help others on the same node,
+		// and only then reach across to remote nodes.
+		for (int pass = 0; pass < 2; ++pass) {
+			for (int i = 0; i < workers; ++i) {
+				int band = (worker + i) % workers;
+				bool local = pool.getNodeOf(band) == pool.getNodeOf(worker);
+				if (local != (pass == 0)) { continue; }
+
+				const int bandEnd = first + (band + 1) * rows / workers;
+
+				for (int y0 = nextRow[band].fetch_add(stripRows); y0 < bandEnd;
+					y0 = nextRow[band].fetch_add(stripRows)) {
+					TraceSpan span("tile", "render", y0);
+
+					for (int y = y0; y < std::min(y0 + stripRows, bandEnd); ++y) {
+						const T py = MapPixel(bottom, top, y, height);
+
+						const int row = y * width + firstColumn;
+
+						// Each row has its own tallies, so workers never share one.
+						uint32_t* shortcuts = pShortcuts + y * statsTilesX;
+
+						if (distance) {
+							DistanceRow<F>(left, right, py, kx, ky, spacing, width, firstColumn, columns, maxIterations,
+								pCounts + row, pImage + row, pDistances + row, shortcuts);
+						}
+						else {
+							EscapeRow<F>(lanes, left, right, py, kx, ky, width, firstColumn, columns, maxIterations,
+								pCounts + row, pImage + row, shortcuts);
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+
+// Neighbours whose iteration counts give colours further apart than
+// this, in any channel, are an edge, for anti-aliasing. Counts a few
+// apart differ by a few grey levels, which is no edge at all.
+const int AA_COLOUR_STEP = 24;
+
+// With distance estimation, pixels closer to the set than this many
+// pixels are edges.
+const float AA_EDGE_PIXELS = 1.0f;
+
+// The point on the complex plane at fractional pixel pos of size.
+template <typename T>
+inline T MapSample(T low, T high, float pos, int size) restrict(cpu, amp)
+{
+	return low + (T(pos) * (high - low) / T((float)size));
+}
+
+inline DoubleDouble MapSample(DoubleDouble low, DoubleDouble high, float pos, int size) restrict(cpu, amp)
+{
+	return low + (high - low) * DoubleDouble((double)pos / size);
+}
+
+template <int N>
+inline Fixed<N> MapSample(Fixed<N> low, Fixed<N> high, float pos, int size) restrict(cpu, amp)
+{
+	return low + (high - low) * Fixed<N>((double)pos / size);
+}
+
+// Well-mixed bits of v, so that jitter is the same on every backend.
+inline unsigned int HashJitter(unsigned int v) restrict(cpu, amp)
+{
+	v ^= v >> 16;
+	v *= 0x7feb352dU;
+	v ^= v >> 15;
+	v *= 0x846ca68bU;
+	v ^= v >> 16;
+	return v;
+}
+
+// The colour of one sample, jittered within cell (sx, sy) of a grid x
+// grid division of pixel (x, y), coloured as the frame was.
+template <typename F, typename T>
+inline uint32_t SampleColour(T left, T right, T top, T bottom, T kx, T ky,
+	unsigned int x, unsigned int y, int sx, int sy, int width, int height, int grid,
+	unsigned int maxIterations, bool distance, float spacing) restrict(cpu, amp)
+{
+	// Hashed pixel then cell, so large images cannot wrap one pixel's
+	// cells onto another's.
+	const unsigned int h = HashJitter(HashJitter(y * width + x) + sy * grid + sx);
+	const float jx = ((h & 0xFFFF) + 0.5f) / 65536.0f;
+	const float jy = ((h >> 16) + 0.5f) / 65536.0f;
+
+	const T px = MapSample(left, right, x + (sx + jx) / grid, width);
+	const T py = MapSample(bottom, top, y + (sy + jy) / grid, height);
+
+	if (distance) {
+		float d;
+		unsigned int iterations = EscapeDistance<F>(px, py, kx, ky, maxIterations, d);
+		return DistanceColour(d, iterations, maxIterations, spacing);
+	}
+	return IterationColour(EscapeIterations<F>(px, py, kx, ky, maxIterations), maxIterations);
+}
+
+// Adds colours channel by channel, and tracks how far apart they are.
+struct ColourSum
+{
+	unsigned int sum[3];
+	int low[3], high[3];
+	unsigned int samples;
+
+	ColourSum() restrict(cpu, amp)
+		: samples(0)
+	{
+		for (int k = 0; k < 3; ++k) { sum[k] = 0; low[k] = 255; high[k] = 0; }
 	}
 
-	// Stop timing
-	the_amp_clock::time_point end = the_amp_clock::now();
+	void Add(uint32_t colour) restrict(cpu, amp)
+	{
+		for (int k = 0; k < 3; ++k) {
+			int channel = (colour >> (16 - 8 * k)) & 0xFF;
+			sum[k] += channel;
+			low[k] = channel < low[k] ? channel : low[k];
+			high[k] = channel > high[k] ? channel : high[k];
+		}
+		++samples;
+	}
 
-	// Compute the difference between the two times in milliseconds
-	auto time_taken = duration_cast<nanoseconds>(end - start).count();
+	bool Uniform() const restrict(cpu, amp)
+	{
+		for (int k = 0; k < 3; ++k) {
+			if (high[k] - low[k] > AA_COLOUR_STEP) { return false; }
+		}
+		return true;
+	}
 
-	if (sample < SAMPLE_SIZE && sample != -1) {
-		results.at(sample) = time_taken;
-		std::cout << "AMP, TS " << TS << ", sample " << sample << ", takes : " << time_taken << " ns." << endl;
+	uint32_t Mean() const restrict(cpu, amp)
+	{
+		uint32_t colour = 0;
+		for (int k = 0; k < 3; ++k) {
+			colour = (colour << 8) | ((sum[k] + samples / 2) / samples);
+		}
+		return colour;
 	}
+};
+
+// The mean colour of pixel (x, y), one jittered sample in each cell of a
+// grid x grid division of it. The four corner cells are sampled first;
+// if they agree, the edge passes the pixel by, and their mean is enough.
+template <typename F, typename T>
+inline uint32_t SuperSample(T left, T right, T top, T bottom, T kx, T ky,
+	unsigned int x, unsigned int y, int width, int height, int grid,
+	unsigned int maxIterations, bool distance, float spacing) restrict(cpu, amp)
+{
+	const int last = grid - 1;
+	ColourSum colours;
 
+	for (int corner = 0; corner < 4; ++corner) {
+		colours.Add(SampleColour<F>(left, right, top, bottom, kx, ky, x, y,
+			(corner & 1) * last, (corner >> 1) * last, width, height, grid, maxIterations, distance, spacing));
+	}
+	if (colours.Uniform()) { return colours.Mean(); }
 
+	for (int sy = 0; sy < grid; ++sy) {
+		for (int sx = 0; sx < grid; ++sx) {
+			// Corners are already taken.
+			if ((sx == 0 || sx == last) && (sy == 0 || sy == last)) { continue; }
 
-	// If necessary, apply blur.
-	if (blur) { ApplyBlur(); }
+			colours.Add(SampleColour<F>(left, right, top, bottom, kx, ky, x, y,
+				sx, sy, width, height, grid, maxIterations, distance, spacing));
+		}
+	}
+	return colours.Mean();
+}
+
+int Mandelbrot::Antialias(int grid)
+{
+	if (grid < 2) { return 0; }
+	grid = std::min(grid, MAX_AA_GRID);
+
+	TraceSpan span("antialias", "render");
+
+	const std::vector<uint32_t> edges = FindEdges();
+	if (edges.empty()) { return 0; }
+
+	std::vector<uint32_t> colours(edges.size());
+
+	switch (KernelPrecision()) {
+	case Precision::DOUBLE:
+		AntialiasAs<double>(viewLeft.hi, viewRight.hi, viewTop.hi, viewBottom.hi, grid, edges, colours);
+		break;
+	case Precision::DOUBLE_DOUBLE:
+		AntialiasAs<DoubleDouble>(viewLeft, viewRight, viewTop, viewBottom, grid, edges, colours);
+		break;
+	case Precision::FIXED64:
+		AntialiasAs<Fixed64>(viewLeft, viewRight, viewTop, viewBottom, grid, edges, colours);
+		break;
+	case Precision::FIXED128:
+		AntialiasAs<Fixed128>(viewLeft, viewRight, viewTop, viewBottom, grid, edges, colours);
+		break;
+	default:
+		AntialiasAs<float>((float)viewLeft.hi, (float)viewRight.hi, (float)viewTop.hi, (float)viewBottom.hi, grid, edges, colours);
+		break;
+	}
+
+	// Edges are only found in the rows computed; mirrored rows take
+	// their reflections' colours, as they took their counts.
+	int supersampled = (int)edges.size();
+	for (size_t i = 0; i < edges.size(); ++i) {
+		image[edges[i]] = colours[i];
+
+		const int x = edges[i] % imageWidth;
+		const int to = mirrorAxis - (int)edges[i] / imageWidth;
+		if (to >= mirrorBegin && to < mirrorEnd) {
+			image[to * imageWidth + x] = colours[i];
+			++supersampled;
+		}
+	}
+	return supersampled;
+}
+
+std::vector<uint32_t> Mandelbrot::FindEdges()
+{
+	const int width = imageWidth;
+	const int height = imageHeight;
+	const unsigned int maxIterations = lastMaxIterations;
+	const bool distance = distanceEstimation && distances.size() == counts.size();
+	const float edgeDistance = (float)(AA_EDGE_PIXELS * getPixelSpacing());
+
+	// Whether two neighbours differ sharply enough to alias.
+	auto differ = [&](int a, int b) {
+		const unsigned int na = counts[a], nb = counts[b];
+		if ((na == maxIterations) != (nb == maxIterations)) { return true; }
+		if (distance) { return false; }
+
+		const uint32_t ca = IterationColour(na, maxIterations), cb = IterationColour(nb, maxIterations);
+		for (int shift = 0; shift < 24; shift += 8) {
+			if (std::abs((int)((ca >> shift) & 0xFF) - (int)((cb >> shift) & 0xFF)) > AA_COLOUR_STEP) { return true; }
+		}
+		return false;
+	};
+
+	std::vector<uint8_t> edge(width * height, 0);
+	std::atomic<int> nextRow(rowBegin);
+
+	Pool().Run([&](int worker) {
+		for (int y = nextRow++; y < rowEnd; y = nextRow++) {
+			for (int x = 0; x < width; ++x) {
+				const int i = y * width + x;
+
+				// With a distance field, an escaping pixel is an edge if
+				// the set passes within a pixel of it.
+				bool marked = distance && counts[i] < maxIterations && distances[i] < edgeDistance;
+
+				// Each sharp difference marks one of its two pixels, the
+				// first along the row or down the column; supersampling it
+				// blends the step between them.
+				marked = marked
+					|| (x + 1 < width && differ(i, i + 1))
+					|| (y + 1 < height && differ(i, i + width));
+
+				edge[i] = marked;
+			}
+		}
+	});
+
+	std::vector<uint32_t> edges;
+	for (int i = 0; i < width * height; ++i) {
+		if (edge[i]) { edges.push_back(i); }
+	}
+	return edges;
+}
+
+template <typename T>
+void Mandelbrot::AntialiasAs(T left, T right, T top, T bottom, int grid,
+	const std::vector<uint32_t>& edges, std::vector<uint32_t>& colours)
+{
+	switch (formula) {
+	case Formula::JULIA: AntialiasWith<JuliaStep>(left, right, top, bottom, grid, edges, colours); break;
+	case Formula::MULTIBROT3: AntialiasWith<MultibrotStep<3>>(left, right, top, bottom, grid, edges, colours); break;
+	case Formula::MULTIBROT4: AntialiasWith<MultibrotStep<4>>(left, right, top, bottom, grid, edges, colours); break;
+	case Formula::BURNING_SHIP: AntialiasWith<BurningShipStep>(left, right, top, bottom, grid, edges, colours); break;
+	default: AntialiasWith<MandelbrotStep>(left, right, top, bottom, grid, edges, colours); break;
+	}
+}
+
+template <typename F, typename T>
+void Mandelbrot::AntialiasWith(T left, T right, T top, T bottom, int grid,
+	const std::vector<uint32_t>& edges, std::vector<uint32_t>& colours)
+{
+	const int width = imageWidth;
+	const int height = imageHeight;
+	const unsigned int maxIterations = lastMaxIterations;
+	const T kx(juliaX), ky(juliaY);
+	const bool distance = distanceEstimation;
+	const float spacing = (float)getPixelSpacing();
+	const int count = (int)edges.size();
+
+	// Double and fixed-point kernels need full double support, as in ComputeAMP.
+	const bool onAccelerator = backend == Backend::AMP
+		&& (sizeof(T) == sizeof(float) || accelerator().supports_double_precision);
+
+	if (onAccelerator) {
+		// One thread per edge pixel, each taking all of its samples.
+		array_view<const uint32_t, 1> e(count, edges.data());
+		array_view<uint32_t, 1> c(count, colours.data());
+		c.discard_data();
+
+		try
+		{
+			parallel_for_each(c.extent, [=](index<1> i) restrict(amp) {
+				const unsigned int x = e[i] % width;
+				const unsigned int y = e[i] / width;
+
+				c[i] = SuperSample<F>(left, right, top, bottom, kx, ky, x, y, width, height, grid,
+					maxIterations, distance, spacing);
+			});
+			c.synchronize();
+		}
+		catch (const Concurrency::runtime_exception& ex)
+		{
+			KernelFailed(ex.what());
+		}
+		return;
+	}
+
+	// Edge pixels cluster, so workers take small runs of them in turn.
+	const int run = 64;
+	std::atomic<int> next(0);
+
+	Pool().Run([&](int worker) {
+		for (int first = next.fetch_add(run); first < count; first = next.fetch_add(run)) {
+			for (int i = first; i < std::min(first + run, count); ++i) {
+				const unsigned int x = edges[i] % width;
+				const unsigned int y = edges[i] / width;
+
+				colours[i] = SuperSample<F>(left, right, top, bottom, kx, ky, x, y, width, height, grid,
+					maxIterations, distance, spacing);
+			}
+		}
+	});
+}
+
+
+void RenderStats::Add(const RenderStats& other)
+{
+	iterations += other.iterations;
+	escaped += other.escaped;
+	interior += other.interior;
+	shortcut += other.shortcut;
+	mirrored += other.mirrored;
+}
+
+const RenderStats& Mandelbrot::ComputeStats()
+{
+	const int tilesX = getStatsTilesX();
+	const int tilesY = (imageHeight + STATS_TILE - 1) / STATS_TILE;
+
+	tileStats.assign(tilesX * tilesY, RenderStats());
+
+	// Nothing has been computed yet if there are no tallies.
+	shortcutRows.resize((size_t)imageHeight * tilesX, 0);
+
+	const unsigned int maxIterations = lastMaxIterations;
+
+	// Rows of tiles are independent, so workers take one at a time.
+	std::atomic<int> nextTileRow(0);
+
+	Pool().Run([&](int worker) {
+		for (int ty = nextTileRow++; ty < tilesY; ty = nextTileRow++) {
+			for (int y = ty * STATS_TILE; y < std::min((ty + 1) * STATS_TILE, imageHeight); ++y) {
+				for (int x = 0; x < imageWidth; ++x) {
+					RenderStats& tile = tileStats[ty * tilesX + x / STATS_TILE];
+					unsigned int n = counts[y * imageWidth + x];
+
+					// A copied row took no work of its own.
+					if (y >= mirrorBegin && y < mirrorEnd) {
+						++tile.mirrored;
+						++(n < maxIterations ? tile.escaped : tile.interior);
+						continue;
+					}
+
+					++(n < maxIterations ? tile.escaped : tile.interior);
+					tile.iterations += n;
+				}
+
+				// The kernels tallied the pixels their cardioid/bulb test
+				// answered, which reached the limit without iterating.
+				for (int tx = 0; tx < tilesX; ++tx) {
+					const uint32_t shortcuts = shortcutRows[y * tilesX + tx];
+					RenderStats& tile = tileStats[ty * tilesX + tx];
+
+					tile.shortcut += shortcuts;
+					tile.iterations -= (long long)shortcuts * maxIterations;
+				}
+			}
+		}
+	});
+
+	frameStats = RenderStats();
+	for (const RenderStats& tile : tileStats) {
+		frameStats.Add(tile);
+	}
+	return frameStats;
+}
+
+// Map 0..1 onto a black, blue, red, yellow, white ramp.
+uint32_t HeatColour(float t)
+{
+	const float stops[5][3] = {
+		{ 0, 0, 0 }, { 0, 0, 255 }, { 255, 0, 0 }, { 255, 255, 0 }, { 255, 255, 255 }
+	};
+
+	float scaled = std::min(std::max(t, 0.0f), 1.0f) * 4.0f;
+	int i = std::min((int)scaled, 3);
+	float f = scaled - i;
+
+	uint32_t channels[3];
+	for (int c = 0; c < 3; ++c) {
+		channels[c] = (uint32_t)(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f);
+	}
+	return (channels[0] << 16) | (channels[1] << 8) | channels[2];
+}
+
+bool Mandelbrot::WriteCostHeatmap(const char* filename)
+{
+	// The tiles may not have been counted yet, or counted for another frame.
+	ComputeStats();
+	const int tilesX = getStatsTilesX();
+
+	long long maxCost = 1;
+	for (const RenderStats& tile : tileStats) {
+		maxCost = std::max(maxCost, tile.iterations);
+	}
+
+	// Log scale, so cheap tiles are not all lost in black.
+	std::vector<uint32_t> heat(imageWidth * imageHeight);
+	for (int y = 0; y < imageHeight; ++y) {
+		for (int x = 0; x < imageWidth; ++x) {
+			const RenderStats& tile = tileStats[(y / STATS_TILE) * tilesX + x / STATS_TILE];
+			heat[y * imageWidth + x] = HeatColour((float)(std::log1p((double)tile.iterations) / std::log1p((double)maxCost)));
+		}
+	}
+
+	return WriteTga(filename, heat.data(), imageWidth, imageHeight);
+}
+
+
+double Mandelbrot::getPixelSpacing()
+{
+	return (viewRight - viewLeft).hi / imageWidth;
+}
+
+void Mandelbrot::ComputeView(double centreX, double centreY, double viewWidth, bool blur)
+{
+	// Keep the pixels square by deriving the view height from the aspect ratio.
+	double viewHeight = viewWidth * imageHeight / imageWidth;
+
+	// Bounds are exact sums, so a view far narrower than the spacing
+	// of doubles about its centre still has distinct edges.
+	ComputeBounds(
+		DoubleDouble(centreX) - DoubleDouble(viewWidth / 2), DoubleDouble(centreX) + DoubleDouble(viewWidth / 2),
+		DoubleDouble(centreY) + DoubleDouble(viewHeight / 2), DoubleDouble(centreY) - DoubleDouble(viewHeight / 2), blur);
+}
+
+IterationChoice Mandelbrot::ChooseIterations(double left, double right, double top, double bottom)
+{
+	return ChooseBounds(left, right, top, bottom);
+}
+
+IterationChoice Mandelbrot::ChooseIterationsView(double centreX, double centreY, double viewWidth)
+{
+	double viewHeight = viewWidth * imageHeight / imageWidth;
+
+	return ChooseBounds(
+		DoubleDouble(centreX) - DoubleDouble(viewWidth / 2), DoubleDouble(centreX) + DoubleDouble(viewWidth / 2),
+		DoubleDouble(centreY) + DoubleDouble(viewHeight / 2), DoubleDouble(centreY) - DoubleDouble(viewHeight / 2));
+}
+
+// Pixels of a probe render which reached the limit, and which escaped in
+// the top half of the limit's range.
+void CountProbe(const ImageBuffer& counts, unsigned int limit, int& unresolved, int& late)
+{
+	unresolved = 0;
+	late = 0;
+	for (uint32_t n : counts) {
+		unresolved += n >= limit;
+		late += n < limit && n > limit / 2;
+	}
+}
+
+IterationChoice Mandelbrot::ChooseBounds(const DoubleDouble& left, const DoubleDouble& right,
+	const DoubleDouble& top, const DoubleDouble& bottom)
+{
+	TraceSpan span("choose iterations", "render");
+
+	IterationChoice choice;
+
+	// Start from the zoom depth.
+	const double octaves = std::max(0.0, std::log2(AUTO_HOME_WIDTH / (right - left).hi));
+	const int fromDepth = AUTO_ITERATIONS_BASE + (int)(AUTO_ITERATIONS_PER_OCTAVE * octaves);
+
+	int limit = AUTO_ITERATIONS_BASE;
+	while (limit < fromDepth && limit < AUTO_ITERATIONS_MAX) { limit *= 2; }
+	choice.depthLimit = limit;
+
+	// The probe renders as this instance would, but counts escapes only.
+	const int probeWidth = AUTO_PROBE_SIZE;
+	const int probeHeight = std::max(1, AUTO_PROBE_SIZE * imageHeight / imageWidth);
+	const int pixels = probeWidth * probeHeight;
+	const int enough = std::max(1, (int)(AUTO_RESOLVE_FRACTION * pixels));
+
+	Mandelbrot probe(probeWidth, probeHeight);
+	probe.CopySettings(*this);
+	probe.setDistanceEstimation(false);
+
+	probe.setMaxIterations((float)limit);
+	probe.ComputeBounds(left, right, top, bottom, false);
+	choice.probes = 1;
+
+	int unresolved, late;
+	CountProbe(probe.GetIterations(), limit, unresolved, late);
+
+	while (limit < AUTO_ITERATIONS_MAX) {
+		// Escape counts which have tailed off well below the limit
+		// leave nothing for a higher one to resolve.
+		if (late < enough || unresolved < enough) { break; }
+
+		probe.setMaxIterations((float)(limit * 2));
+		probe.ComputeBounds(left, right, top, bottom, false);
+		++choice.probes;
+
+		int higherUnresolved, higherLate;
+		CountProbe(probe.GetIterations(), limit * 2, higherUnresolved, higherLate);
+
+		// Keep the lower limit if doubling resolved too few new pixels.
+		if (unresolved - higherUnresolved < enough) { break; }
+
+		limit *= 2;
+		unresolved = higherUnresolved;
+		late = higherLate;
+	}
+
+	choice.limit = limit;
+	choice.unresolved = (double)unresolved / pixels;
+
+	MAX_ITERATIONS = limit;
+	return choice;
+}
+
+void Mandelbrot::CopySettings(const Mandelbrot& other)
+{
+	backend = other.backend;
+	precision = other.precision;
+	formula = other.formula;
+	juliaX = other.juliaX;
+	juliaY = other.juliaY;
+	distanceEstimation = other.distanceEstimation;
+	errorDialogs = other.errorDialogs;
+	workerPool = other.workerPool;
+	MAX_ITERATIONS = other.MAX_ITERATIONS;
+}
+
+void Mandelbrot::StartProgressive(double left, double right, double top, double bottom, int coarseFactor, int tile)
+{
+	TraceSpan span("progressive coarse", "render");
+
+	// The mean tile time carries over, scaled by area, to a new tile size.
+	if (tile != tileSize) {
+		tileMillis *= (double)tile * tile / ((double)tileSize * tileSize);
+		tileSize = tile;
+	}
+
+	viewLeft = left; viewRight = right;
+	viewTop = top; viewBottom = bottom;
+	lastMaxIterations = MAX_ITERATIONS;
+	kernelError.clear();
+	shortcutRows.assign((size_t)imageHeight * getStatsTilesX(), 0);
+
+	if (distanceEstimation && distances.size() != image.size()) {
+		distances.resize(image.size());
+	}
+
+	// With no coarse level, the image keeps what it held until each tile
+	// is rendered, for a caller which covers it with a preview of its own.
+	if (coarseFactor > 0) {
+		const int coarseWidth = std::max(1, imageWidth / coarseFactor);
+		const int coarseHeight = std::max(1, imageHeight / coarseFactor);
+
+		if (!coarseLevel || coarseLevel->imageWidth != coarseWidth || coarseLevel->imageHeight != coarseHeight) {
+			coarseLevel.reset(new Mandelbrot(coarseWidth, coarseHeight));
+		}
+		coarseLevel->CopySettings(*this);
+		coarseLevel->ComputeBounds(viewLeft, viewRight, viewTop, viewBottom, false);
+
+		// Each coarse pixel stands in for the block of pixels it covers.
+		// Rows within a block are the same, so each is only filled once.
+		std::vector<int> columns(imageWidth);
+		for (int x = 0; x < imageWidth; ++x) { columns[x] = x * coarseWidth / imageWidth; }
+
+		for (int y = 0; y < imageHeight; ++y) {
+			const int cy = y * coarseHeight / imageHeight;
+			const int row = y * imageWidth;
+
+			if (y > 0 && cy == (y - 1) * coarseHeight / imageHeight) {
+				std::copy(image.begin() + row - imageWidth, image.begin() + row, image.begin() + row);
+				std::copy(counts.begin() + row - imageWidth, counts.begin() + row, counts.begin() + row);
+				if (distanceEstimation) {
+					std::copy(distances.begin() + row - imageWidth, distances.begin() + row, distances.begin() + row);
+				}
+				continue;
+			}
+
+			for (int x = 0; x < imageWidth; ++x) {
+				const int c = cy * coarseWidth + columns[x];
+
+				image[row + x] = coarseLevel->image[c];
+				counts[row + x] = coarseLevel->counts[c];
+				if (distanceEstimation) { distances[row + x] = coarseLevel->distances[c]; }
+			}
+		}
+	}
+
+	// Tiles cover only the rows to compute; each one fills in its
+	// reflection as it is rendered.
+	FindMirror(viewTop, viewBottom);
+
+	// Tiles nearest the centre, where the eye is, come first.
+	const int tilesX = (imageWidth + tileSize - 1) / tileSize;
+	const int tilesY = (rowEnd - rowBegin + tileSize - 1) / tileSize;
+
+	tileOrder.resize(tilesX * tilesY);
+	for (int t = 0; t < (int)tileOrder.size(); ++t) { tileOrder[t] = t; }
+
+	auto centreDistance = [&](int t) {
+		const double dx = (t % tilesX + 0.5) * tileSize - imageWidth / 2.0;
+		const double dy = rowBegin + (t / tilesX + 0.5) * tileSize - imageHeight / 2.0;
+		return dx * dx + dy * dy;
+	};
+	std::stable_sort(tileOrder.begin(), tileOrder.end(), [&](int a, int b) {
+		return centreDistance(a) < centreDistance(b);
+	});
+
+	nextTile = 0;
+}
+
+bool Mandelbrot::ContinueProgressive(double budgetMillis)
+{
+	typedef std::chrono::steady_clock the_tile_clock;
+	const the_tile_clock::time_point start = the_tile_clock::now();
+
+	// Tiles render at the limit the frame started with.
+	const int frameIterations = MAX_ITERATIONS;
+	MAX_ITERATIONS = (int)lastMaxIterations;
+
+	for (int rendered = 0; nextTile < tileOrder.size(); ++rendered) {
+		const the_tile_clock::time_point tileStart = the_tile_clock::now();
+
+		// Stop short of a tile that, going by those before, would overrun.
+		const double spent = std::chrono::duration<double, std::milli>(tileStart - start).count();
+		if (rendered > 0 && spent + tileMillis > budgetMillis) { break; }
+
+		TraceSpan span("progressive tile", "render", (int)nextTile);
+
+		// The tile's pixels of the whole view, mapped exactly as a whole
+		// render maps them, so the finished frame is the same image.
+		const sf::IntRect tile = getTileRect(nextTile);
+		computeRect = tile;
+
+		if (backend == Backend::CPU) {
+			ComputeCPU(viewLeft, viewRight, viewTop, viewBottom);
+		}
+		else {
+			ComputeAMP(viewLeft, viewRight, viewTop, viewBottom);
+		}
+
+		MirrorRows(tile.top, tile.top + tile.height, tile.left, tile.left + tile.width);
+		++nextTile;
+
+		// A running mean, which follows the view's cost as tiles change.
+		const double taken = std::chrono::duration<double, std::milli>(the_tile_clock::now() - tileStart).count();
+		tileMillis = tileMillis > 0.0 ? 0.75 * tileMillis + 0.25 * taken : taken;
+	}
+
+	MAX_ITERATIONS = frameIterations;
+	return ProgressiveComplete();
+}
+
+sf::IntRect Mandelbrot::getTileRect(size_t i) const
+{
+	const int tilesX = (imageWidth + tileSize - 1) / tileSize;
+	const int x0 = tileOrder[i] % tilesX * tileSize;
+	const int y0 = rowBegin + tileOrder[i] / tilesX * tileSize;
+
+	return sf::IntRect(x0, y0, std::min(tileSize, imageWidth - x0), std::min(tileSize, rowEnd - y0));
+}
+
+sf::IntRect Mandelbrot::getTileMirrorRect(size_t i) const
+{
+	const sf::IntRect tile = getTileRect(i);
+
+	// Rows reflect in reverse order, so the tile's last row is the first.
+	const int y0 = std::max(mirrorBegin, mirrorAxis - (tile.top + tile.height - 1));
+	const int y1 = std::min(mirrorEnd, mirrorAxis - tile.top + 1);
+
+	return sf::IntRect(tile.left, y0, tile.width, std::max(0, y1 - y0));
 }
 
 
@@ -206,11 +1573,18 @@ struct ConvolutionKernel {
 
 void Mandelbrot::ApplyBlur()
 {
+	// The blur passes tile by whole rows and columns, which fixes
+	// their sizes at compile time to those of the window.
+	if (imageWidth != WIDTH || imageHeight != HEIGHT) {
+		cout << "Blur is only available for " << WIDTH << "x" << HEIGHT << " images." << endl;
+		return;
+	}
+
 	// For local capture.
 	ConvolutionKernel Separable;
 
-	// Local pointer to the globally declared image data.
-	uint32_t* pImage = &(image[0][0]);
+	// Local pointer to this instance's image data.
+	uint32_t* pImage = image.data();
 
 
 	// Device memory resources...
@@ -257,15 +1631,20 @@ void Mandelbrot::ApplyBlur()
 			avImageOut[idx] = (((uint32_t)red << 16) | ((uint32_t)green << 8) | (uint32_t)blue);
 		}
 	};
-	parallel_for_each(avImageIn.extent.tile<WIDTH, 1>(), singleBlurPass);
+	{
+		TraceSpan span("blur horizontal", "blur");
 
-	avImageOut.synchronize();
+		parallel_for_each(avImageIn.extent.tile<WIDTH, 1>(), singleBlurPass);
+		avImageOut.synchronize();
+	}
 
 
 	// Swap source and destination in preparation for vertical pass.
 	std::swap(avImageIn, avImageOut);
 	avImageOut.discard_data();
 
+	TraceSpan span("blur vertical", "blur");
+
 
 	parallel_for_each(avImageIn.extent.tile<1, HEIGHT>(), [=](tiled_index<1, HEIGHT> t_idx) restrict(amp) {
 		// Local copy of global index.
@@ -302,28 +1681,3 @@ void Mandelbrot::setMaxIterations(float iterations)
 	// Update maximum iterations.
 	MAX_ITERATIONS = iterations;
 }
-
-void Mandelbrot::PrintResults()
-{
-	// After a double line break, print results.
-	std::cout << std::endl << std::endl;
-
-	for (const auto &ns : results) {
-
-		std::cout << ns << std::endl;
-	}
-
-	std::cout << "\n\nPerformance measurements taken, and available to copy.\n";
-}
-
-Mandelbrot::~Mandelbrot()
-{
-	// Delete uint8_t array of pixels.
-	delete[] pixels;
-	pixels = NULL;
-
-	/*for (uint8_t* p : pixels) {
-
-		delete p;
-	}*/
-}
\ No newline at end of file
@@ -8,22 +8,144 @@
 #include <cstdlib>
 #include <complex>
 #include <array>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <amp.h>
 #include <amp_math.h>
 
-#include <fstream>
+#include "DoubleDouble.h"
 
+#include <fstream>
 
-// Number of samples for gathering of
-// parallel function timings.
-const int SAMPLE_SIZE = 200;
 
 // The size of the image to generate.
 const int WIDTH = 1024; // 1920
 const int HEIGHT = 1024; // 1200
 
 
+// Allocator which leaves elements uninitialised, so that the pages of
+// a new buffer are first touched by the thread that computes them.
+template <typename T>
+struct FirstTouchAllocator : std::allocator<T>
+{
+	template <typename U> struct rebind { typedef FirstTouchAllocator<U> other; };
+
+	FirstTouchAllocator() = default;
+	template <typename U> FirstTouchAllocator(const FirstTouchAllocator<U>&) {}
+
+	template <typename U> void construct(U* p) { ::new ((void*)p) U; }
+	template <typename U, typename... Args> void construct(U* p, Args&&... args) { ::new ((void*)p) U(std::forward<Args>(args)...); }
+};
+
+typedef std::vector<uint32_t, FirstTouchAllocator<uint32_t>> ImageBuffer;
+typedef std::vector<float, FirstTouchAllocator<float>> DistanceBuffer;
+
+class WorkerPool;
+
+
+// Where the Mandelbrot kernel runs.
+enum class Backend { AMP, CPU };
+
+
+// Scalar type the kernels iterate in. Each is its own instance of the
+// same templated kernel; long double is left out, as it is plain double
+// under MSVC and not allowed in restrict(amp) code. The fixed-point
+// types (FixedPoint.h) give bit-identical images on every backend.
+enum class Precision { FLOAT, DOUBLE, DOUBLE_DOUBLE, FIXED64, FIXED128 };
+
+
+// Iteration formula the kernels run, each a compile-time policy in
+// Formula.h: z^2 + c, z^2 + k from z0 = the point, z^3 + c, z^4 + c,
+// and the Burning Ship.
+enum class Formula { MANDELBROT, JULIA, MULTIBROT3, MULTIBROT4, BURNING_SHIP };
+
+
+// Render settings the auto-tuner calibrates for each machine.
+struct TuneConfig
+{
+	// Edge of the square AMP tile: 8, 16 or 32.
+	int ampTileSize = 8;
+
+	// CPU workers to render with; zero uses the whole pool.
+	int cpuThreads = 0;
+
+	// Rows a CPU worker claims at a time.
+	int cpuStripRows = 4;
+
+	// Pixels the CPU kernel iterates together: 1, 4, 8 or 16.
+	int simdLanes = 1;
+};
+
+
+// Edge length, in pixels, of the tiles work is counted over.
+const int STATS_TILE = 32;
+
+
+// Automatic iteration limits. A view starts from a limit which grows
+// with its zoom depth, from the base at the home view's width by so many
+// per halving of the width, rounded up to a power of two. A probe render
+// then doubles it, up to the maximum, while each doubling still lets at
+// least the given fraction of the probe's pixels escape.
+const double AUTO_HOME_WIDTH = 3.0;
+const int AUTO_ITERATIONS_BASE = 256;
+const int AUTO_ITERATIONS_PER_OCTAVE = 64;
+const int AUTO_ITERATIONS_MAX = 65536;
+const double AUTO_RESOLVE_FRACTION = 0.005;
+
+// Width of the probe render, in pixels; its height keeps the aspect ratio.
+const int AUTO_PROBE_SIZE = 64;
+
+
+// Progressive rendering: edge of the full-resolution tiles, and the
+// factor the coarse level, which stands in for unfinished tiles, is
+// scaled down by.
+const int PROGRESSIVE_TILE = 64;
+const int PROGRESSIVE_COARSE_FACTOR = 8;
+
+// Furthest, in pixels, the reflection of a row in the real axis may fall
+// from another row for the one to be copied from the other.
+const double MIRROR_ALIGNMENT = 1.0e-6;
+
+// Finest anti-aliasing grid; a pixel's grid x grid samples are summed
+// and hashed in 32 bits.
+const int MAX_AA_GRID = 16;
+
+// The limit ChooseIterations settled on, and the probe's findings there.
+struct IterationChoice
+{
+	int limit = 0;
+
+	// Limit taken from the zoom depth alone.
+	int depthLimit = 0;
+
+	// Probe renders made, and the fraction of probe pixels still
+	// unresolved (at the limit) at the chosen limit.
+	int probes = 0;
+	double unresolved = 0.0;
+};
+
+// Work counters for a tile or a whole frame.
+struct RenderStats
+{
+	// Iterations actually performed; shortcut pixels cost none.
+	long long iterations = 0;
+
+	long long escaped = 0;
+	long long interior = 0;
+
+	// Interior pixels resolved by the cardioid/bulb test.
+	long long shortcut = 0;
+
+	// Pixels copied from their reflection in the real axis, which cost
+	// nothing either; they are not counted as shortcut.
+	long long mirrored = 0;
+
+	void Add(const RenderStats& other);
+};
+
+
 class Mandelbrot
 {
 private:
@@ -33,32 +155,279 @@ private:
 	int MAX_ITERATIONS = 500;
 
 
+	// Dimensions of this instance's image, in pixels.
+	int imageWidth, imageHeight;
+
+	// The image data.
+	// Each pixel is represented as 0xRRGGBB.
+	ImageBuffer image;
+
+	// Escape iteration count of each pixel, row-major.
+	ImageBuffer counts;
+
+	// Estimated distance of each pixel from the set, row-major, while
+	// distance estimation is on.
+	DistanceBuffer distances;
+
 	// An array of pixels to update an sf::Texture.
-	uint8_t* pixels = new uint8_t[HEIGHT * WIDTH * 4];
+	std::vector<uint8_t> pixels;
+
+	// View and limit of the last computation, for counting its work.
+	DoubleDouble viewLeft, viewRight, viewTop, viewBottom;
+	unsigned int lastMaxIterations = 0;
+
+	std::vector<RenderStats> tileStats;
+
+	// Pixels of each row of the last computation which the kernel's
+	// cardioid/bulb test answered, per STATS_TILE columns.
+	std::vector<uint32_t> shortcutRows;
+
+	// Mirroring: the kernels compute rows [rowBegin, rowEnd), and rows
+	// [mirrorBegin, mirrorEnd) are copies of their reflections, row
+	// mirrorAxis - y for row y. Without a reflection, every row is computed.
+	int rowBegin = 0, rowEnd = 0;
+	int mirrorAxis = 0, mirrorBegin = 0, mirrorEnd = 0;
+
+	// The pixels the next kernel call computes, mapped as part of the
+	// whole view: those rows, or one progressive tile of them.
+	sf::IntRect computeRect;
+
+	// Progressive rendering: a renderer for the coarse level, the
+	// frame's tiles in the order they are rendered, nearest the centre
+	// first, the next one due, and the mean time tiles take.
+	std::unique_ptr<Mandelbrot> coarseLevel;
+	std::vector<int> tileOrder;
+	int tileSize = PROGRESSIVE_TILE;
+	size_t nextTile = 0;
+	double tileMillis = 0.0;
+	RenderStats frameStats;
+
+	// Backend used by this instance, and by new instances.
+	Backend backend = defaultBackend;
+	static Backend defaultBackend;
+
+	// Process-wide render settings.
+	static TuneConfig tuning;
+
+	// Precision used by this instance, and by new instances.
+	Precision precision = defaultPrecision;
+	static Precision defaultPrecision;
+
+	// The precision the kernels actually run in. Distance estimation's
+	// bailout is far outside the fixed-point range, so it iterates fixed
+	// point views in double instead.
+	Precision KernelPrecision() const;
 
-	// A container of results of timings.
-	std::array<long long, SAMPLE_SIZE> results;
+	// Formula used by this instance, and by new instances, with the
+	// constant k of the Julia formula.
+	Formula formula = defaultFormula;
+	static Formula defaultFormula;
+	double juliaX = defaultJuliaX, juliaY = defaultJuliaY;
+	static double defaultJuliaX, defaultJuliaY;
+
+	// Whether this instance, and new instances, estimate distances.
+	bool distanceEstimation = defaultDistanceEstimation;
+	static bool defaultDistanceEstimation;
+
+	// Threads the CPU backend renders on; null for the shared pool.
+	WorkerPool* workerPool = nullptr;
+	WorkerPool& Pool() const;
+
+	// Why the accelerator failed the last computation, if it did, and
+	// whether such failures are also shown in a dialog.
+	std::string kernelError;
+	bool errorDialogs = true;
+	void KernelFailed(const char* what);
+
+	// Per-backend kernels behind ComputeMandelbrot, which pick the
+	// instance for this precision, then for this formula.
+	void ComputeAMP(const DoubleDouble& left, const DoubleDouble& right, const DoubleDouble& top, const DoubleDouble& bottom);
+	void ComputeCPU(const DoubleDouble& left, const DoubleDouble& right, const DoubleDouble& top, const DoubleDouble& bottom);
+	template <typename T> void ComputeAMPAs(T left, T right, T top, T bottom);
+	template <typename T> void ComputeCPUAs(T left, T right, T top, T bottom);
+	template <typename F, typename T> void ComputeAMPWith(T left, T right, T top, T bottom);
+	template <typename F, typename T> void ComputeCPUWith(T left, T right, T top, T bottom);
+
+	// View bounds are carried in double-double, so the double-double
+	// kernel can resolve views narrower than a double's spacing.
+	void ComputeBounds(const DoubleDouble& left, const DoubleDouble& right,
+		const DoubleDouble& top, const DoubleDouble& bottom, bool blur);
+	IterationChoice ChooseBounds(const DoubleDouble& left, const DoubleDouble& right,
+		const DoubleDouble& top, const DoubleDouble& bottom);
+
+	// Anti-aliasing: the pixels of the last frame which straddle an edge,
+	// and their supersampled colours at each precision and formula.
+	std::vector<uint32_t> FindEdges();
+	template <typename T> void AntialiasAs(T left, T right, T top, T bottom, int grid,
+		const std::vector<uint32_t>& edges, std::vector<uint32_t>& colours);
+	template <typename F, typename T> void AntialiasWith(T left, T right, T top, T bottom, int grid,
+		const std::vector<uint32_t>& edges, std::vector<uint32_t>& colours);
+
+	// Whether the formula's image is its own reflection in the real axis:
+	// any but the burning ship, whose absolute values break the symmetry,
+	// and Julia sets of a constant off the axis.
+	bool MirrorSymmetric() const;
+
+	// Set the rows to compute and to mirror for a view, mirroring the
+	// larger half's reflection onto the smaller wherever a view crossing
+	// the axis puts each reflected row on another.
+	void FindMirror(const DoubleDouble& top, const DoubleDouble& bottom);
+
+	// Copy rows [y0, y1), columns [x0, x1) onto their reflections.
+	void MirrorRows(int y0, int y1, int x0, int x1);
 
 public:
-	// Specify destructor for clean up.
-	~Mandelbrot();
+	// Image dimensions default to those of the interactive window.
+	Mandelbrot(int width = WIDTH, int height = HEIGHT);
 
 	// Compute mandelbrot image based off of minimum and
 	// maximum complex coordinates.
-	void ComputeMandelbrot(float left, float right,
-		float top, float bottom, bool blur = false, int sample = -1);
+	void ComputeMandelbrot(double left, double right,
+		double top, double bottom, bool blur = false);
+
+	// Compute mandelbrot image about a centre point, deriving
+	// the view height from the image's aspect ratio.
+	void ComputeView(double centreX, double centreY, double viewWidth, bool blur = false);
+
+	// Anti-alias the last computation: pixels whose iteration count
+	// differs sharply from the next pixel's along the row or down the
+	// column, or, with distance estimation, which lie within a pixel of
+	// the set, are recoloured as the mean of grid x grid jittered
+	// samples, for a grid of 2 to MAX_AA_GRID. Other pixels keep their
+	// one sample, and mirrored rows copy their reflection's. Returns the
+	// number of pixels supersampled.
+	int Antialias(int grid);
 
-	// Apply Gaussian blur to image.
+	// Render a frame within a time budget, for interactive use.
+	// StartProgressive renders the view at 1/coarseFactor resolution,
+	// scaled up into the image, or with a coarseFactor of 0 leaves the
+	// image as it was, and queues its tiles, tile pixels wide.
+	// ContinueProgressive then renders queued tiles at full resolution
+	// until about budgetMillis have passed, taking at least one, and
+	// returns true once none remain; until then the image is part fine,
+	// part coarse.
+	void StartProgressive(double left, double right, double top, double bottom,
+		int coarseFactor = PROGRESSIVE_COARSE_FACTOR, int tile = PROGRESSIVE_TILE);
+	bool ContinueProgressive(double budgetMillis);
+	bool ProgressiveComplete() const { return nextTile >= tileOrder.size(); };
+
+	// The number of the frame's tiles rendered so far, and the pixels
+	// the i-th of them to be rendered covers, clipped to the image.
+	size_t getTilesDone() const { return nextTile; };
+	sf::IntRect getTileRect(size_t i) const;
+
+	// The pixels mirrored from the i-th tile, which are empty if none are.
+	sf::IntRect getTileMirrorRect(size_t i) const;
+
+	// Move a view which crosses the real axis by under half a pixel, so
+	// that its rows' reflections fall on other rows, and half the rows
+	// it shares with its reflection can be mirrored rather than computed.
+	void AlignToAxis(double& top, double& bottom) const;
+
+	// Take another instance's backend, precision, formula, Julia
+	// constant, distance estimation and maximum iterations.
+	void CopySettings(const Mandelbrot& other);
+
+	// Apply Gaussian blur to image (window-sized images only).
 	void ApplyBlur();
 
 	// Maximum iterations getter and setter.
 	int getMaxIterations() { return MAX_ITERATIONS; };
 	void setMaxIterations(float iterations);
 
+	// Pick, and set, the maximum iterations for a view from its zoom depth
+	// and the escape counts of a small probe render of it, made with this
+	// instance's backend, precision and formula. The limit only rises
+	// above the depth's while rising still resolves new pixels.
+	IterationChoice ChooseIterations(double left, double right, double top, double bottom);
+	IterationChoice ChooseIterationsView(double centreX, double centreY, double viewWidth);
+
+	// Backend getters and setters.
+	Backend getBackend() { return backend; };
+	void setBackend(Backend use) { backend = use; };
+	static void setDefaultBackend(Backend use) { defaultBackend = use; };
+	static Backend getDefaultBackend() { return defaultBackend; };
+	static const char* BackendName(Backend backend);
+
+	// Precision getters and setters.
+	Precision getPrecision() { return precision; };
+	void setPrecision(Precision use) { precision = use; };
+	static void setDefaultPrecision(Precision use) { defaultPrecision = use; };
+	static Precision getDefaultPrecision() { return defaultPrecision; };
+	static const char* PrecisionName(Precision precision);
+	static bool ParsePrecision(const std::string& name, Precision& precision);
+
+	// Formula getters and setters.
+	Formula getFormula() { return formula; };
+	void setFormula(Formula use) { formula = use; };
+	static void setDefaultFormula(Formula use) { defaultFormula = use; };
+	static Formula getDefaultFormula() { return defaultFormula; };
+	static const char* FormulaName(Formula formula);
+	static bool ParseFormula(const std::string& name, Formula& formula);
+
+	// Julia constant getters and setters.
+	double getJuliaX() { return juliaX; };
+	double getJuliaY() { return juliaY; };
+	void setJulia(double x, double y) { juliaX = x; juliaY = y; };
+	static void setDefaultJulia(double x, double y) { defaultJuliaX = x; defaultJuliaY = y; };
+
+	// Distance estimation getters and setters. While on, the kernels
+	// carry dz/dc alongside z, and shade each pixel by its estimated
+	// distance from the set rather than by its iteration count.
+	bool getDistanceEstimation() { return distanceEstimation; };
+	void setDistanceEstimation(bool use) { distanceEstimation = use; };
+	static void setDefaultDistanceEstimation(bool use) { defaultDistanceEstimation = use; };
+
+	// The accelerator's message if it failed the last computation, else
+	// empty. Headless callers turn off the dialog, which would wait for a
+	// user who is not there, and check this instead.
+	const std::string& getKernelError() { return kernelError; };
+	void setErrorDialogs(bool show) { errorDialogs = show; };
+
+	// Render on a pool of one's own, not the shared one, which only one
+	// caller can use at a time. The pool must outlive the instance.
+	void setWorkerPool(WorkerPool* pool) { workerPool = pool; };
+
+	// Render settings getter and setter, shared by every instance.
+	static const TuneConfig& getTuning() { return tuning; };
+	static void setTuning(const TuneConfig& config) { tuning = config; };
+
+	// Image dimension getters.
+	int getWidth() { return imageWidth; };
+	int getHeight() { return imageHeight; };
+
 	// Write/Receive the generated image data to a file/to window.
-	void WriteTga(const char* filename);
+	bool WriteTga(const char* filename);
+	void EncodeTga(std::vector<uint8_t>& tga);
 	sf::Uint8* GetMandelPixels();
 
-	// Print timing results without annotations (to copy).
-	void PrintResults();
+	// Raw colours and iteration counts from the last computation.
+	const ImageBuffer& GetImage() { return image; };
+	const ImageBuffer& GetIterations() { return counts; };
+
+	// Distance of each pixel from the set, in units of the complex plane,
+	// from the last computation with distance estimation on. Zero for
+	// pixels which didn't escape. Divide by getPixelSpacing for pixels.
+	const DistanceBuffer& GetDistances() { return distances; };
+
+	// Width of one pixel on the complex plane, in the last computation.
+	double getPixelSpacing();
+
+	// Count the work done by the last computation, per STATS_TILE tile
+	// and for the whole frame. This is a pass over the iteration counts
+	// and the kernels' shortcut tallies, so costs nothing unless asked for.
+	const RenderStats& ComputeStats();
+	const std::vector<RenderStats>& GetTileStats() { return tileStats; };
+	int getStatsTilesX() { return (imageWidth + STATS_TILE - 1) / STATS_TILE; };
+
+	// Write the per-tile iteration cost of the last computation, counted
+	// afresh by ComputeStats, as an image the same size as the Mandelbrot image.
+	bool WriteCostHeatmap(const char* filename);
+
+	// Write any 0xRRGGBB buffer to a TGA file.
+	static bool WriteTga(const char* filename, const uint32_t* colours, int width, int height);
+	static void EncodeTga(const uint32_t* colours, int width, int height, std::vector<uint8_t>& tga);
+
+	// Copy a separately rendered tile of colours into the image.
+	void SetTile(int x, int y, int width, int height, const std::vector<uint32_t>& colours);
 };
\ No newline at end of file
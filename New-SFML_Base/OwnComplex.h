@@ -3,21 +3,65 @@
 
 // A custom Complex number class is required as the Complex
 // type is not available in the Concurrency namespace.
+//
+// T is the scalar type: float, double, DoubleDouble or a LanePack of
+// any of them. Every kernel is written once against OwnComplex<T> and
+// instantiated per precision at compile time. constexpr is left off,
+// since these members must also compile under restrict(amp).
 
-
+template <typename T>
 class OwnComplex
 {
 private:
 	// Complex coordinates.
-	float x, y;
+	T x, y;
 
 public:
-	// Specified constructor and setter.
-	OwnComplex() restrict(cpu, amp);
-	void SetXY(float setX, float setY) restrict(cpu, amp);
+	// Specified constructors and setter.
+	OwnComplex() restrict(cpu, amp)
+		: x(T(0.0)), y(T(0.0)) {}
+	OwnComplex(const T& setX, const T& setY) restrict(cpu, amp)
+		: x(setX), y(setY) {}
+
+	void SetXY(const T& setX, const T& setY) restrict(cpu, amp) { x = setX; y = setY; }
+	const T& GetX() const restrict(cpu, amp) { return x; }
+	const T& GetY() const restrict(cpu, amp) { return y; }
 
 	// Operations.
-	void Add(OwnComplex c2) restrict(cpu, amp);
-	float Absolute() restrict(cpu, amp);
-	void Multiply(OwnComplex c2) restrict(cpu, amp);
-};
\ No newline at end of file
+	void Add(const OwnComplex& c2) restrict(cpu, amp)
+	{
+		x = x + c2.x;
+		y = y + c2.y;
+	}
+
+	void Multiply(const OwnComplex& c2) restrict(cpu, amp)
+	{
+		// The new x is held until y, which depends on the old x, is done.
+		T newX = x * c2.x - y * c2.y;
+		y = y * c2.x + x * c2.y;
+		x = newX;
+	}
+
+	// s * z, for a real s.
+	void Scale(const T& s) restrict(cpu, amp)
+	{
+		x = s * x;
+		y = s * y;
+	}
+
+	// z * z. Doubling is exact in floating point, so xy + xy is the
+	// same 2xy as before, and spares fixed point a multiply.
+	void Square() restrict(cpu, amp)
+	{
+		T newX = x * x - y * y;
+		const T xy = x * y;
+		y = xy + xy;
+		x = newX;
+	}
+
+	// |z|^2, so bailout tests need no square root.
+	T SquaredMagnitude() const restrict(cpu, amp)
+	{
+		return x * x + y * y;
+	}
+};
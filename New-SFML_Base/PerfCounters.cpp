@@ -0,0 +1,145 @@
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+double PerfSample::Ipc() const
+{
+	if (!has(PerfEvent::CYCLES) || !has(PerfEvent::INSTRUCTIONS) || get(PerfEvent::CYCLES) == 0) {
+		return 0.0;
+	}
+	return (double)get(PerfEvent::INSTRUCTIONS) / get(PerfEvent::CYCLES);
+}
+
+void PerfSample::Add(const PerfSample& other)
+{
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		values[i] += other.values[i];
+		valid[i] = other.valid[i];
+	}
+}
+
+void PerfSample::Divide(int frames)
+{
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		values[i] /= frames > 0 ? frames : 1;
+	}
+}
+
+const char* PerfCounters::EventName(PerfEvent event)
+{
+	switch (event) {
+	case PerfEvent::CYCLES: return "cycles";
+	case PerfEvent::INSTRUCTIONS: return "instructions";
+	case PerfEvent::L1D_MISSES: return "l1d_misses";
+	case PerfEvent::LLC_MISSES: return "llc_misses";
+	case PerfEvent::BRANCH_MISSES: return "branch_misses";
+	default: return "unknown";
+	}
+}
+
+bool PerfCounters::IsAvailable() const
+{
+	for (int fd : fds) {
+		if (fd >= 0) { return true; }
+	}
+	return false;
+}
+
+#if defined(__linux__)
+
+PerfCounters::PerfCounters()
+{
+	const struct { uint32_t type; uint64_t config; } events[PERF_EVENT_COUNT] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+			| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.disabled = 1;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// Events are opened separately rather than as a group, since
+		// inherited counters can't be read as a group, so the kernel may
+		// multiplex them; scale by time running to compensate.
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		// This process, any processor.
+		fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+}
+
+PerfCounters::~PerfCounters()
+{
+	for (int fd : fds) {
+		if (fd >= 0) { close(fd); }
+	}
+}
+
+void PerfCounters::Start()
+{
+	for (int fd : fds) {
+		if (fd < 0) { continue; }
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+}
+
+PerfSample PerfCounters::Stop()
+{
+	for (int fd : fds) {
+		if (fd >= 0) { ioctl(fd, PERF_EVENT_IOC_DISABLE, 0); }
+	}
+
+	PerfSample sample;
+	for (int i = 0; i < PERF_EVENT_COUNT; ++i) {
+		// Value, time enabled, time running.
+		uint64_t data[3];
+		if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+			continue;
+		}
+
+		sample.values[i] = (long long)((double)data[0] * data[1] / data[2]);
+		sample.valid[i] = true;
+	}
+	return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+	for (int& fd : fds) { fd = -1; }
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::Start()
+{
+}
+
+PerfSample PerfCounters::Stop()
+{
+	return PerfSample();
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+
+// Hardware events counted around each benchmark frame.
+enum class PerfEvent { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, COUNT };
+
+const int PERF_EVENT_COUNT = (int)PerfEvent::COUNT;
+
+
+// Event totals over one or more measured regions. An event the
+// machine or kernel would not count is left invalid.
+struct PerfSample
+{
+	long long values[PERF_EVENT_COUNT] = {};
+	bool valid[PERF_EVENT_COUNT] = {};
+
+	long long get(PerfEvent event) const { return values[(int)event]; };
+	bool has(PerfEvent event) const { return valid[(int)event]; };
+
+	// Instructions per cycle, or zero if either is missing.
+	double Ipc() const;
+
+	void Add(const PerfSample& other);
+	void Divide(int frames);
+};
+
+
+// Hardware performance counters for this process, via perf_event_open.
+// Only available on Linux; elsewhere every sample is empty.
+//
+// Counters are inherited by threads created after they are opened, so
+// construct this before the shared worker pool starts its threads.
+class PerfCounters
+{
+private:
+	int fds[PERF_EVENT_COUNT];
+
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	PerfCounters(const PerfCounters&) = delete;
+	PerfCounters& operator=(const PerfCounters&) = delete;
+
+	// True if at least one event could be opened.
+	bool IsAvailable() const;
+
+	// Zero and start the counters, then stop and read them.
+	void Start();
+	PerfSample Stop();
+
+	static const char* EventName(PerfEvent event);
+};
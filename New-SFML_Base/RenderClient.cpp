@@ -0,0 +1,35 @@
+#include "RenderClient.h"
+
+#include <iostream>
+
+
+bool RenderClient::Connect(const sf::IpAddress& host, unsigned short port)
+{
+	if (socket.connect(host, port, sf::seconds(5.0f)) != sf::Socket::Done) {
+		std::cout << "Unable to connect to " << host << ":" << port << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool RenderClient::Send(const RenderRequest& request)
+{
+	sf::Packet packet;
+	packet << request;
+	return socket.send(packet) == sf::Socket::Done;
+}
+
+bool RenderClient::Receive(RenderResponse& response)
+{
+	sf::Packet packet;
+	if (socket.receive(packet) != sf::Socket::Done) { return false; }
+
+	return (bool)(packet >> response);
+}
+
+void RenderClient::Shutdown()
+{
+	RenderRequest request;
+	request.type = RequestType::SHUTDOWN;
+	Send(request);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "RenderProtocol.h"
+
+
+// Submits render requests to a RenderServer.
+class RenderClient
+{
+private:
+	sf::TcpSocket socket;
+
+public:
+	bool Connect(const sf::IpAddress& host, unsigned short port = RENDER_PORT);
+
+	// Requests may be sent back to back and their responses collected
+	// afterwards, letting the server batch them.
+	bool Send(const RenderRequest& request);
+	bool Receive(RenderResponse& response);
+
+	// Ask the server to stop once queued requests are served.
+	void Shutdown();
+};
@@ -0,0 +1,68 @@
+#include "RenderProtocol.h"
+
+
+sf::Packet& operator<<(sf::Packet& packet, const RenderRequest& request)
+{
+	return packet << request.id << (sf::Uint8)request.type << (sf::Uint8)request.format
+		<< request.centreX << request.centreY << request.viewWidth
+		<< request.iterations << request.imageWidth << request.imageHeight;
+}
+
+sf::Packet& operator>>(sf::Packet& packet, RenderRequest& request)
+{
+	sf::Uint8 type = 0, format = 0;
+
+	packet >> request.id >> type >> format
+		>> request.centreX >> request.centreY >> request.viewWidth
+		>> request.iterations >> request.imageWidth >> request.imageHeight;
+
+	request.type = (RequestType)type;
+	request.format = (PayloadFormat)format;
+	return packet;
+}
+
+sf::Packet& operator<<(sf::Packet& packet, const RenderResponse& response)
+{
+	return packet << response.id << response.ok << (sf::Uint8)response.format
+		<< response.imageWidth << response.imageHeight
+		<< response.queueMicros << response.serviceMicros << response.cached
+		<< response.payload;
+}
+
+sf::Packet& operator>>(sf::Packet& packet, RenderResponse& response)
+{
+	sf::Uint8 format = 0;
+
+	packet >> response.id >> response.ok >> format
+		>> response.imageWidth >> response.imageHeight
+		>> response.queueMicros >> response.serviceMicros >> response.cached
+		>> response.payload;
+
+	response.format = (PayloadFormat)format;
+	return packet;
+}
+
+
+void PackBuffer(const uint32_t* words, size_t count, std::string& payload)
+{
+	payload.resize(count * 4);
+
+	// Byte order is fixed so that either end may be big-endian.
+	for (size_t i = 0; i < count; ++i) {
+		payload[i * 4] = (char)(words[i] & 0xFF);
+		payload[i * 4 + 1] = (char)((words[i] >> 8) & 0xFF);
+		payload[i * 4 + 2] = (char)((words[i] >> 16) & 0xFF);
+		payload[i * 4 + 3] = (char)((words[i] >> 24) & 0xFF);
+	}
+}
+
+void UnpackBuffer(const std::string& payload, std::vector<uint32_t>& words)
+{
+	words.resize(payload.size() / 4);
+
+	const unsigned char* bytes = (const unsigned char*)payload.data();
+	for (size_t i = 0; i < words.size(); ++i) {
+		words[i] = (uint32_t)bytes[i * 4] | ((uint32_t)bytes[i * 4 + 1] << 8)
+			| ((uint32_t)bytes[i * 4 + 2] << 16) | ((uint32_t)bytes[i * 4 + 3] << 24);
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <SFML/Network.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Port the render service listens on unless told otherwise.
+const unsigned short RENDER_PORT = 53000;
+
+
+// What a client is asking the service to do.
+enum class RequestType : sf::Uint8 { RENDER, SHUTDOWN };
+
+// How the rendered image is returned.
+enum class PayloadFormat : sf::Uint8 { ITERATIONS, TGA, COLOURS };
+
+
+// A viewport to render, as sent by a client.
+struct RenderRequest
+{
+	sf::Uint32 id = 0;
+	RequestType type = RequestType::RENDER;
+	PayloadFormat format = PayloadFormat::TGA;
+
+	double centreX = 0.0, centreY = 0.0;
+	double viewWidth = 0.0;
+
+	// Zero lets the renderer choose the limit for the view.
+	sf::Uint32 iterations = 0;
+	sf::Uint32 imageWidth = 0, imageHeight = 0;
+};
+
+// The service's answer to a single RenderRequest.
+struct RenderResponse
+{
+	sf::Uint32 id = 0;
+	bool ok = false;
+	PayloadFormat format = PayloadFormat::TGA;
+	sf::Uint32 imageWidth = 0, imageHeight = 0;
+
+	// Time spent waiting in the queue and being rendered.
+	sf::Uint32 queueMicros = 0, serviceMicros = 0;
+
+	// True when served from the result cache.
+	bool cached = false;
+
+	// Encoded TGA, or little-endian 32-bit iteration counts or 0xRRGGBB colours.
+	std::string payload;
+};
+
+
+sf::Packet& operator<<(sf::Packet& packet, const RenderRequest& request);
+sf::Packet& operator>>(sf::Packet& packet, RenderRequest& request);
+sf::Packet& operator<<(sf::Packet& packet, const RenderResponse& response);
+sf::Packet& operator>>(sf::Packet& packet, RenderResponse& response);
+
+// Convert 32-bit buffers (iteration counts or colours) to and from a response payload.
+void PackBuffer(const uint32_t* words, size_t count, std::string& payload);
+void UnpackBuffer(const std::string& payload, std::vector<uint32_t>& words);
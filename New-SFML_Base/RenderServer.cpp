@@ -0,0 +1,418 @@
+#include "RenderServer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// Import things we need from the standard library
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::cout;
+using std::endl;
+
+// Print a latency summary after this many requests.
+const int STATS_INTERVAL = 100;
+
+// Longest the server keeps sending queued responses once shut down.
+const float SHUTDOWN_SEND_SECONDS = 5.0f;
+
+
+RenderServer::RenderServer(int workers)
+	: nextConnection(0),
+	workerCount(workers > 0 ? workers : std::max(1, (int)std::thread::hardware_concurrency())),
+	running(false),
+	requestsServed(0),
+	cacheHits(0),
+	batches(0)
+{
+}
+
+RenderServer::~RenderServer()
+{
+	running = false;
+	queueReady.notify_all();
+
+	for (std::thread& t : workers) {
+		if (t.joinable()) { t.join(); }
+	}
+}
+
+bool RenderServer::Listen(unsigned short port, const sf::IpAddress& address)
+{
+	if (listener.listen(port, address) != sf::Socket::Done) {
+		cout << "Unable to listen on " << address << ":" << port << endl;
+		return false;
+	}
+	selector.add(listener);
+
+	cout << "Render server listening on " << address << ":" << port
+		<< " with " << workerCount << " workers" << endl;
+	return true;
+}
+
+void RenderServer::Run()
+{
+	running = true;
+
+	// Start the warm worker pool.
+	for (int i = 0; i < workerCount; ++i) {
+		workers.emplace_back(&RenderServer::WorkerLoop, this);
+	}
+
+	while (running) {
+		// Wake regularly to send finished responses.
+		if (selector.wait(sf::milliseconds(2))) {
+			if (selector.isReady(listener)) { AcceptClient(); }
+
+			for (auto it = clients.begin(); it != clients.end() && running; ) {
+				// Receiving may disconnect the client, so step past it first.
+				auto current = it++;
+				if (selector.isReady(*current->second.socket)) {
+					ReceiveFrom(current->first, *current->second.socket);
+				}
+			}
+		}
+		FlushOutbox();
+	}
+
+	// Let the workers finish and deliver what is already queued.
+	queueReady.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+	workers.clear();
+
+	sf::Clock sending;
+	FlushOutbox();
+	while (SendsPending() && sending.getElapsedTime().asSeconds() < SHUTDOWN_SEND_SECONDS) {
+		sf::sleep(sf::milliseconds(2));
+		FlushOutbox();
+	}
+
+	PrintStats();
+}
+
+void RenderServer::AcceptClient()
+{
+	std::unique_ptr<sf::TcpSocket> client(new sf::TcpSocket);
+
+	if (listener.accept(*client) == sf::Socket::Done) {
+		client->setBlocking(false);
+		selector.add(*client);
+		clients[nextConnection++].socket = std::move(client);
+	}
+}
+
+void RenderServer::ReceiveFrom(sf::Uint32 connection, sf::TcpSocket& client)
+{
+	sf::Packet packet;
+
+	sf::Socket::Status status = client.receive(packet);
+
+	// Part of a packet has arrived; the socket keeps it until the rest does.
+	if (status == sf::Socket::NotReady || status == sf::Socket::Partial) { return; }
+
+	if (status != sf::Socket::Done) {
+		DropClient(connection);
+		return;
+	}
+
+	RenderRequest request;
+	if (!(packet >> request)) {
+		cout << "Discarding malformed request" << endl;
+		return;
+	}
+
+	if (request.type == RequestType::SHUTDOWN) {
+		running = false;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueLock);
+		queue.push_back({ request, connection, the_server_clock::now() });
+	}
+	queueReady.notify_one();
+}
+
+void RenderServer::DropClient(sf::Uint32 connection)
+{
+	// Client went away; any of its responses still in flight are dropped.
+	selector.remove(*clients[connection].socket);
+	clients.erase(connection);
+}
+
+void RenderServer::FlushOutbox()
+{
+	std::vector<OutgoingResponse> sending;
+	{
+		std::lock_guard<std::mutex> lock(outboxLock);
+		sending.swap(outbox);
+	}
+
+	for (OutgoingResponse& out : sending) {
+		auto client = clients.find(out.connection);
+		if (client == clients.end()) { continue; }
+
+		client->second.unsent.emplace_back();
+		client->second.unsent.back() << out.response;
+	}
+
+	// Send what each client will take without blocking. A partly sent
+	// packet remembers how far it got, and is sent again from there.
+	for (auto it = clients.begin(); it != clients.end(); ) {
+		auto current = it++;
+		std::deque<sf::Packet>& unsent = current->second.unsent;
+
+		sf::Socket::Status status = sf::Socket::Done;
+		while (!unsent.empty() && (status = current->second.socket->send(unsent.front())) == sf::Socket::Done) {
+			unsent.pop_front();
+		}
+
+		if (status == sf::Socket::Disconnected || status == sf::Socket::Error) {
+			DropClient(current->first);
+		}
+	}
+}
+
+bool RenderServer::SendsPending() const
+{
+	for (const auto& client : clients) {
+		if (!client.second.unsent.empty()) { return true; }
+	}
+	return false;
+}
+
+void RenderServer::WorkerLoop()
+{
+	WarmBuffers warm;
+
+	std::vector<PendingRequest> batch;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(queueLock);
+			queueReady.wait(lock, [this]() { return !queue.empty() || !running; });
+
+			if (queue.empty()) { return; }
+
+			// Take the oldest request and, to a limit, the queued duplicates
+			// of its viewport, which are then rendered only once. Other
+			// requests are left for the other workers.
+			const std::string key = CacheKey(queue.front().request);
+			batch.push_back(queue.front());
+			queue.pop_front();
+
+			for (auto it = queue.begin(); it != queue.end() && (int)batch.size() < MAX_BATCH; ) {
+				if (CacheKey(it->request) == key) {
+					batch.push_back(*it);
+					it = queue.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+
+			if (!queue.empty()) { queueReady.notify_one(); }
+		}
+
+		ServeBatch(batch, warm);
+		batch.clear();
+	}
+}
+
+void RenderServer::ServeBatch(std::vector<PendingRequest>& batch, WarmBuffers& warm)
+{
+	// Responses rendered in this batch, keyed like the result cache.
+	std::map<std::string, RenderResponse> rendered;
+	std::vector<OutgoingResponse> replies;
+
+	for (PendingRequest& pending : batch) {
+		const RenderRequest& request = pending.request;
+
+		RenderResponse response;
+		std::string key = CacheKey(request);
+
+		// Queued time runs until this request's turn, including the wait
+		// behind earlier requests in the same batch.
+		the_server_clock::time_point start = the_server_clock::now();
+		sf::Uint32 queueMicros = (sf::Uint32)duration_cast<microseconds>(start - pending.received).count();
+
+		auto shared = rendered.find(key);
+		if (shared != rendered.end()) {
+			response = shared->second;
+			response.cached = true;
+		}
+		else if (FindCached(key, response)) {
+			response.cached = true;
+		}
+		else if (!Renderable(request)) {
+			response.ok = false;
+		}
+		else {
+			Render(request, WarmBuffer(warm, request.imageWidth, request.imageHeight), response);
+
+			// A failed render is answered as such, and tried again if asked.
+			if (response.ok) {
+				rendered[key] = response;
+				StoreCached(key, response);
+			}
+		}
+
+		response.id = request.id;
+		response.queueMicros = queueMicros;
+		response.serviceMicros = (sf::Uint32)duration_cast<microseconds>(the_server_clock::now() - start).count();
+
+		RecordLatency(response.queueMicros, response.serviceMicros, response.cached);
+		replies.push_back({ pending.connection, response });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(statsLock);
+		++batches;
+	}
+
+	std::lock_guard<std::mutex> lock(outboxLock);
+	for (OutgoingResponse& reply : replies) {
+		outbox.push_back(std::move(reply));
+	}
+}
+
+bool RenderServer::Renderable(const RenderRequest& request)
+{
+	return request.imageWidth > 0 && request.imageWidth <= MAX_REQUEST_SIDE
+		&& request.imageHeight > 0 && request.imageHeight <= MAX_REQUEST_SIDE
+		&& request.viewWidth > 0.0;
+}
+
+Mandelbrot& RenderServer::WarmBuffer(WarmBuffers& warm, int width, int height)
+{
+	const std::pair<int, int> size(width, height);
+
+	for (auto it = warm.begin(); it != warm.end(); ++it) {
+		if (it->first == size) {
+			// Move to the front as most recently used.
+			warm.splice(warm.begin(), warm, it);
+			return *warm.front().second;
+		}
+	}
+
+	if ((int)warm.size() >= WARM_BUFFERS) { warm.pop_back(); }
+	warm.emplace_front(size, std::unique_ptr<Mandelbrot>(new Mandelbrot(width, height)));
+	return *warm.front().second;
+}
+
+void RenderServer::Render(const RenderRequest& request, Mandelbrot& mandel, RenderResponse& response)
+{
+	// Shared with TileWorker, which renders the same requests one at a time.
+	// Neither has a display to show a kernel failure on.
+	mandel.setErrorDialogs(false);
+
+	if (request.iterations == 0) {
+		mandel.ChooseIterationsView(request.centreX, request.centreY, request.viewWidth);
+	}
+	else {
+		mandel.setMaxIterations((float)request.iterations);
+	}
+	mandel.ComputeView(request.centreX, request.centreY, request.viewWidth);
+
+	response.ok = mandel.getKernelError().empty();
+	if (!response.ok) { return; }
+
+	response.format = request.format;
+	response.imageWidth = request.imageWidth;
+	response.imageHeight = request.imageHeight;
+
+	if (request.format == PayloadFormat::ITERATIONS) {
+		PackBuffer(mandel.GetIterations().data(), mandel.GetIterations().size(), response.payload);
+	}
+	else if (request.format == PayloadFormat::COLOURS) {
+		PackBuffer(mandel.GetImage().data(), mandel.GetImage().size(), response.payload);
+	}
+	else {
+		std::vector<uint8_t> tga;
+		mandel.EncodeTga(tga);
+		response.payload.assign(tga.begin(), tga.end());
+	}
+}
+
+
+std::string RenderServer::CacheKey(const RenderRequest& request)
+{
+	std::ostringstream key;
+	key << std::setprecision(17) << request.centreX << ' ' << request.centreY << ' '
+		<< request.viewWidth << ' ' << request.iterations << ' ' << request.imageWidth << ' '
+		<< request.imageHeight << ' ' << (int)request.format;
+	return key.str();
+}
+
+bool RenderServer::FindCached(const std::string& key, RenderResponse& response)
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	for (auto it = resultCache.begin(); it != resultCache.end(); ++it) {
+		if (it->first == key) {
+			// Move to the front as most recently used.
+			resultCache.splice(resultCache.begin(), resultCache, it);
+			response = it->second;
+			return true;
+		}
+	}
+	return false;
+}
+
+void RenderServer::StoreCached(const std::string& key, const RenderResponse& response)
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	resultCache.emplace_front(key, response);
+	if ((int)resultCache.size() > RESULT_CACHE_SIZE) { resultCache.pop_back(); }
+}
+
+
+void RenderServer::RecordLatency(sf::Uint32 queueMicros, sf::Uint32 serviceMicros, bool cached)
+{
+	bool report = false;
+	{
+		std::lock_guard<std::mutex> lock(statsLock);
+
+		queueLatency.push_back(queueMicros);
+		serviceLatency.push_back(serviceMicros);
+		if ((int)queueLatency.size() > LATENCY_WINDOW) {
+			queueLatency.pop_front();
+			serviceLatency.pop_front();
+		}
+
+		++requestsServed;
+		if (cached) { ++cacheHits; }
+		report = requestsServed % STATS_INTERVAL == 0;
+	}
+
+	if (report) { PrintStats(); }
+}
+
+void RenderServer::PrintStats()
+{
+	std::lock_guard<std::mutex> lock(statsLock);
+
+	if (requestsServed == 0) { return; }
+
+	// Summarise a window of samples as mean, median, p99 and max.
+	auto summarise = [](const char* label, std::deque<sf::Uint32> samples) {
+		std::sort(samples.begin(), samples.end());
+
+		double total = 0.0;
+		for (sf::Uint32 us : samples) { total += us; }
+
+		cout << "  " << label << " mean " << std::fixed << std::setprecision(0) << total / samples.size()
+			<< " us, p50 " << samples[samples.size() / 2]
+			<< " us, p99 " << samples[std::min(samples.size() - 1, samples.size() * 99 / 100)]
+			<< " us, max " << samples.back() << " us" << endl;
+	};
+
+	cout << "Served " << requestsServed << " requests in " << batches << " batches ("
+		<< cacheHits << " from cache)" << endl;
+	summarise("queue  ", queueLatency);
+	summarise("service", serviceLatency);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Mandelbrot.h"
+#include "RenderProtocol.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Most duplicates of one request a worker takes from the queue in one go.
+const int MAX_BATCH = 16;
+
+// Number of recent responses kept for repeat requests.
+const int RESULT_CACHE_SIZE = 32;
+
+// Number of latency samples kept for percentile reporting.
+const int LATENCY_WINDOW = 1024;
+
+// Largest image side a request may ask for; larger ones are refused.
+const sf::Uint32 MAX_REQUEST_SIDE = 4096;
+
+// Number of resolutions a worker keeps an image buffer warm for.
+const int WARM_BUFFERS = 4;
+
+// Image buffers kept warm between requests, most recently used first.
+typedef std::list<std::pair<std::pair<int, int>, std::unique_ptr<Mandelbrot>>> WarmBuffers;
+
+
+// A long-running render service. Clients connect over TCP and submit
+// RenderRequest packets; warm worker threads render them and reply with
+// a RenderResponse.
+class RenderServer
+{
+private:
+	typedef std::chrono::steady_clock the_server_clock;
+
+	// A request waiting for a worker, and where to send the answer.
+	struct PendingRequest
+	{
+		RenderRequest request;
+		sf::Uint32 connection;
+		the_server_clock::time_point received;
+	};
+
+	// A response waiting to be sent by the network thread.
+	struct OutgoingResponse
+	{
+		sf::Uint32 connection;
+		RenderResponse response;
+	};
+
+	// A connected client. Its socket never blocks, so a slow client only
+	// delays its own responses; those not yet fully sent wait here.
+	struct Client
+	{
+		std::unique_ptr<sf::TcpSocket> socket;
+		std::deque<sf::Packet> unsent;
+	};
+
+	// Network state, only touched by the thread inside Run().
+	sf::TcpListener listener;
+	sf::SocketSelector selector;
+	std::map<sf::Uint32, Client> clients;
+	sf::Uint32 nextConnection;
+
+	// Requests waiting to be rendered.
+	std::deque<PendingRequest> queue;
+	std::mutex queueLock;
+	std::condition_variable queueReady;
+
+	// Responses waiting to be sent.
+	std::vector<OutgoingResponse> outbox;
+	std::mutex outboxLock;
+
+	// Warm worker threads, kept for the lifetime of the server.
+	std::vector<std::thread> workers;
+	int workerCount;
+	std::atomic<bool> running;
+
+	// Most recently used responses first.
+	std::list<std::pair<std::string, RenderResponse>> resultCache;
+	std::mutex cacheLock;
+
+	// Rolling latency samples in microseconds.
+	std::deque<sf::Uint32> queueLatency, serviceLatency;
+	long long requestsServed, cacheHits, batches;
+	std::mutex statsLock;
+
+	void AcceptClient();
+	void ReceiveFrom(sf::Uint32 connection, sf::TcpSocket& client);
+	void DropClient(sf::Uint32 connection);
+	void FlushOutbox();
+	bool SendsPending() const;
+
+	void WorkerLoop();
+	void ServeBatch(std::vector<PendingRequest>& batch, WarmBuffers& warm);
+
+	static std::string CacheKey(const RenderRequest& request);
+	bool FindCached(const std::string& key, RenderResponse& response);
+	void StoreCached(const std::string& key, const RenderResponse& response);
+
+	void RecordLatency(sf::Uint32 queueMicros, sf::Uint32 serviceMicros, bool cached);
+	void PrintStats();
+
+public:
+	// A worker count of zero uses one per hardware thread.
+	RenderServer(int workers = 0);
+	~RenderServer();
+
+	// Bind to a port. Requests are not authenticated, so only local
+	// clients are accepted unless another interface is given.
+	bool Listen(unsigned short port = RENDER_PORT, const sf::IpAddress& address = sf::IpAddress::LocalHost);
+
+	// Serve requests until a client sends a shutdown request.
+	void Run();
+
+	// Whether a request asks for an image the service will render.
+	static bool Renderable(const RenderRequest& request);
+
+	// The warm image buffer for a resolution, made if there is none; the
+	// least recently used is dropped to keep WARM_BUFFERS.
+	static Mandelbrot& WarmBuffer(WarmBuffers& warm, int width, int height);
+
+	// Render a single request into a response using the given image. A
+	// kernel failure gives a response which is not ok, with no payload.
+	static void Render(const RenderRequest& request, Mandelbrot& mandel, RenderResponse& response);
+};
@@ -0,0 +1,33 @@
+#include "SceneSuite.h"
+
+
+const std::vector<BenchScene>& StandardScenes()
+{
+	static const std::vector<BenchScene> scenes = {
+		// The interactive application's starting view.
+		{ "home", -0.5, 0.0, 3.0, 500 },
+
+		// Spirals between the main cardioid and the period-2 bulb.
+		{ "seahorse", -0.7453, 0.1127, 0.01, 1000 },
+
+		// Mostly main cardioid, so nearly every pixel runs to the limit.
+		{ "cardioid", -0.3, 0.0, 1.0, 2000 },
+
+		// The real-axis antenna near the Feigenbaum point, where
+		// escaping pixels take thousands of iterations. Wide enough that
+		// single precision, about 1.2e-7 apart here, resolves 1024 pixels.
+		{ "filament", -1.401155, 0.0, 1.0e-3, 5000 },
+
+		// As deep as single precision still resolves distinct pixels.
+		{ "deep", -0.743643887037151, 0.131825904205330, 2.0e-4, 4000 },
+	};
+	return scenes;
+}
+
+const BenchScene* FindScene(const std::string& name)
+{
+	for (const BenchScene& scene : StandardScenes()) {
+		if (scene.name == name) { return &scene; }
+	}
+	return nullptr;
+}
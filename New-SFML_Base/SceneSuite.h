@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Bump whenever a scene is added, removed or changed, so that
+// baselines recorded against an older suite are not compared.
+// Also bumped when the meaning of a reported figure changes
+// (2: Giter/s counts only iterations actually performed;
+// 3: filament widened to a view single precision resolves).
+const int SCENE_SUITE_VERSION = 3;
+
+
+// A named view to time or check.
+struct BenchScene
+{
+	std::string name;
+	double centreX, centreY;
+	double viewWidth;
+	int iterations;
+};
+
+// The standard scenes, from cheapest to deepest.
+const std::vector<BenchScene>& StandardScenes();
+
+// Find a standard scene by name, or nullptr.
+const BenchScene* FindScene(const std::string& name);
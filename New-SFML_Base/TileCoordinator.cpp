@@ -0,0 +1,225 @@
+#include "TileCoordinator.h"
+
+#include <algorithm>
+#include <iomanip>
+
+// Import things we need from the standard library
+using std::cout;
+using std::endl;
+
+
+TileCoordinator::TileCoordinator(int tile)
+	: nextWorker(0),
+	tileSize(tile > 0 ? tile : DEFAULT_TILE_SIZE)
+{
+}
+
+bool TileCoordinator::Listen(unsigned short port)
+{
+	if (listener.listen(port) != sf::Socket::Done) {
+		cout << "Unable to listen on port " << port << endl;
+		return false;
+	}
+	selector.add(listener);
+
+	cout << "Coordinator waiting for workers on port " << port << endl;
+	return true;
+}
+
+void TileCoordinator::AcceptWorker()
+{
+	std::unique_ptr<sf::TcpSocket> socket(new sf::TcpSocket);
+
+	if (listener.accept(*socket) == sf::Socket::Done) {
+		selector.add(*socket);
+
+		cout << "Worker " << nextWorker << " joined from " << socket->getRemoteAddress() << endl;
+
+		Worker& worker = workers[nextWorker++];
+		worker.socket = std::move(socket);
+		worker.tilesDone = 0;
+		worker.pixelsDone = 0;
+	}
+}
+
+void TileCoordinator::DropWorker(sf::Uint32 id, std::deque<Tile>& pending, const char* reason)
+{
+	Worker& worker = workers[id];
+
+	cout << "Worker " << id << " " << reason << ", retrying its " << worker.inFlight.size() << " tiles" << endl;
+
+	// Put its unfinished tiles back at the front of the queue.
+	for (auto& held : worker.inFlight) {
+		Tile tile = held.second;
+		++tile.attempts;
+		pending.push_front(tile);
+	}
+
+	selector.remove(*worker.socket);
+	workers.erase(id);
+}
+
+bool TileCoordinator::DispatchTile(Worker& worker, const BatchJob& job, std::deque<Tile>& pending, sf::Uint32 tileId)
+{
+	Tile tile = pending.front();
+	pending.pop_front();
+
+	// Map the tile to its own viewport with the frame's pixel spacing.
+	double pixelSize = job.viewWidth / job.imageWidth;
+	double frameLeft = job.centreX - job.viewWidth / 2;
+	double frameBottom = job.centreY - pixelSize * job.imageHeight / 2;
+
+	RenderRequest request;
+	request.id = tileId;
+	request.format = PayloadFormat::COLOURS;
+	request.centreX = frameLeft + (tile.x + tile.width / 2.0) * pixelSize;
+	request.centreY = frameBottom + (tile.y + tile.height / 2.0) * pixelSize;
+	request.viewWidth = tile.width * pixelSize;
+	request.iterations = job.iterations;
+	request.imageWidth = tile.width;
+	request.imageHeight = tile.height;
+
+	sf::Packet packet;
+	packet << request;
+
+	if (worker.inFlight.empty()) { worker.quiet.restart(); }
+	worker.inFlight[tileId] = tile;
+	return worker.socket->send(packet) == sf::Socket::Done;
+}
+
+bool TileCoordinator::ReceiveTile(Worker& worker, Mandelbrot& mandel, std::deque<Tile>& pending, int& completed)
+{
+	sf::Packet packet;
+	RenderResponse response;
+
+	if (worker.socket->receive(packet) != sf::Socket::Done || !(packet >> response)) { return false; }
+	worker.quiet.restart();
+
+	auto held = worker.inFlight.find(response.id);
+	if (held == worker.inFlight.end()) { return true; }
+
+	Tile tile = held->second;
+	worker.inFlight.erase(held);
+
+	std::vector<uint32_t> colours;
+	UnpackBuffer(response.payload, colours);
+
+	if (!response.ok || (int)colours.size() != tile.width * tile.height) {
+		// The worker is alive but the tile is not; try it again elsewhere.
+		++tile.attempts;
+		pending.push_back(tile);
+		return true;
+	}
+
+	mandel.SetTile(tile.x, tile.y, tile.width, tile.height, colours);
+
+	++worker.tilesDone;
+	worker.pixelsDone += tile.width * tile.height;
+	++completed;
+	return true;
+}
+
+bool TileCoordinator::Render(const BatchJob& job, Mandelbrot& mandel)
+{
+	typedef std::chrono::steady_clock the_tile_clock;
+
+	// Split the frame into tiles, clipping those on the right and top edges.
+	std::deque<Tile> pending;
+	for (int y = 0; y < job.imageHeight; y += tileSize) {
+		for (int x = 0; x < job.imageWidth; x += tileSize) {
+			pending.push_back({ x, y,
+				std::min(tileSize, job.imageWidth - x), std::min(tileSize, job.imageHeight - y), 0 });
+		}
+	}
+	const int tileCount = (int)pending.size();
+
+	for (auto& entry : workers) {
+		entry.second.tilesDone = 0;
+		entry.second.pixelsDone = 0;
+	}
+
+	int completed = 0, abandoned = 0;
+	sf::Uint32 nextTileId = 0;
+	sf::Clock idle;
+	bool waiting = false;
+
+	the_tile_clock::time_point start = the_tile_clock::now();
+
+	while (completed + abandoned < tileCount) {
+		// Keep every worker topped up with tiles.
+		for (auto it = workers.begin(); it != workers.end(); ) {
+			auto current = it++;
+			while (!pending.empty() && (int)current->second.inFlight.size() < TILES_IN_FLIGHT) {
+				// Give up on tiles that have failed too often.
+				if (pending.front().attempts >= MAX_TILE_ATTEMPTS) {
+					pending.pop_front();
+					++abandoned;
+					continue;
+				}
+				if (!DispatchTile(current->second, job, pending, nextTileId++)) {
+					DropWorker(current->first, pending, "lost");
+					break;
+				}
+			}
+		}
+
+		if (workers.empty()) {
+			if (!waiting) {
+				cout << "No workers connected, waiting..." << endl;
+				waiting = true;
+			}
+			if (idle.getElapsedTime().asSeconds() > WORKER_WAIT_SECONDS) { break; }
+		}
+		else {
+			waiting = false;
+			idle.restart();
+		}
+
+		if (selector.wait(sf::milliseconds(100))) {
+			if (selector.isReady(listener)) { AcceptWorker(); }
+
+			for (auto it = workers.begin(); it != workers.end(); ) {
+				auto current = it++;
+				if (selector.isReady(*current->second.socket)
+					&& !ReceiveTile(current->second, mandel, pending, completed)) {
+					DropWorker(current->first, pending, "lost");
+				}
+			}
+		}
+
+		// A worker that has stopped answering is as good as gone.
+		for (auto it = workers.begin(); it != workers.end(); ) {
+			auto current = it++;
+			if (!current->second.inFlight.empty()
+				&& current->second.quiet.getElapsedTime().asSeconds() > TILE_TIMEOUT_SECONDS) {
+				DropWorker(current->first, pending, "timed out");
+			}
+		}
+	}
+
+	std::chrono::duration<double> wallTime = the_tile_clock::now() - start;
+	long long pixels = (long long)job.imageWidth * job.imageHeight;
+
+	// Per-worker share of the frame, then the aggregate rate.
+	for (auto& entry : workers) {
+		cout << "  worker " << entry.first << ": " << entry.second.tilesDone << " tiles, "
+			<< std::fixed << std::setprecision(2) << entry.second.pixelsDone / wallTime.count() / 1.0e6 << " Mpixel/s" << endl;
+	}
+	cout << job.output << ": " << completed << "/" << tileCount << " tiles in "
+		<< std::setprecision(3) << wallTime.count() << " s, "
+		<< std::setprecision(2) << pixels / wallTime.count() / 1.0e6 << " Mpixel/s aggregate" << endl;
+
+	return completed == tileCount;
+}
+
+void TileCoordinator::Shutdown()
+{
+	RenderRequest request;
+	request.type = RequestType::SHUTDOWN;
+
+	for (auto& entry : workers) {
+		sf::Packet packet;
+		packet << request;
+		entry.second.socket->send(packet);
+	}
+}
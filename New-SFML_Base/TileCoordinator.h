@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BatchRender.h"
+#include "RenderProtocol.h"
+
+#include <deque>
+#include <map>
+#include <memory>
+
+// Default edge length of a distributed tile, in pixels.
+const int DEFAULT_TILE_SIZE = 128;
+
+// Tiles requested from each worker before it has answered,
+// hiding the round trip behind rendering.
+const int TILES_IN_FLIGHT = 2;
+
+// A tile that fails this many times is abandoned.
+const int MAX_TILE_ATTEMPTS = 3;
+
+// How long to wait for a worker when none are connected.
+const float WORKER_WAIT_SECONDS = 30.0f;
+
+// How long a worker holding tiles may go without answering before it is
+// treated as lost.
+const float TILE_TIMEOUT_SECONDS = 30.0f;
+
+
+// Splits frames into tiles and hands them to TileWorker processes over
+// TCP. Workers are sent another tile whenever they answer one, so faster
+// workers render more; tiles held by a worker that disconnects are queued
+// again for the others.
+class TileCoordinator
+{
+private:
+	// A rectangle of the frame, in pixels.
+	struct Tile
+	{
+		int x, y;
+		int width, height;
+		int attempts;
+	};
+
+	struct Worker
+	{
+		std::unique_ptr<sf::TcpSocket> socket;
+
+		// Tiles sent and not yet answered, by request id.
+		std::map<sf::Uint32, Tile> inFlight;
+
+		// Time since the worker last answered, or was given work while idle.
+		sf::Clock quiet;
+
+		long long tilesDone;
+		long long pixelsDone;
+	};
+
+	sf::TcpListener listener;
+	sf::SocketSelector selector;
+	std::map<sf::Uint32, Worker> workers;
+	sf::Uint32 nextWorker;
+
+	int tileSize;
+
+	void AcceptWorker();
+	void DropWorker(sf::Uint32 id, std::deque<Tile>& pending, const char* reason);
+	bool DispatchTile(Worker& worker, const BatchJob& job, std::deque<Tile>& pending, sf::Uint32 tileId);
+	bool ReceiveTile(Worker& worker, Mandelbrot& mandel, std::deque<Tile>& pending, int& completed);
+
+public:
+	TileCoordinator(int tile = DEFAULT_TILE_SIZE);
+
+	bool Listen(unsigned short port);
+
+	// Render one frame across the connected workers into mandel.
+	// Returns false if tiles could not be completed.
+	bool Render(const BatchJob& job, Mandelbrot& mandel);
+
+	// Tell every connected worker to exit.
+	void Shutdown();
+};
@@ -0,0 +1,52 @@
+#include "TileWorker.h"
+
+// Import things we need from the standard library
+using std::cout;
+using std::endl;
+
+
+TileWorker::TileWorker()
+	: tilesRendered(0)
+{
+}
+
+bool TileWorker::Connect(const sf::IpAddress& host, unsigned short port)
+{
+	if (socket.connect(host, port, sf::seconds(5.0f)) != sf::Socket::Done) {
+		cout << "Unable to connect to coordinator at " << host << ":" << port << endl;
+		return false;
+	}
+	cout << "Connected to coordinator at " << host << ":" << port << endl;
+	return true;
+}
+
+void TileWorker::Run()
+{
+	for (;;) {
+		sf::Packet packet;
+		RenderRequest request;
+
+		if (socket.receive(packet) != sf::Socket::Done || !(packet >> request)) { break; }
+		if (request.type == RequestType::SHUTDOWN) { break; }
+
+		RenderResponse response;
+
+		// A failed tile is answered as such, so the coordinator retries it.
+		if (RenderServer::Renderable(request)) {
+			RenderServer::Render(request, RenderServer::WarmBuffer(warm, request.imageWidth, request.imageHeight), response);
+		}
+		response.id = request.id;
+
+		if (!response.ok) {
+			cout << "Tile " << request.id << " failed" << endl;
+		}
+
+		packet.clear();
+		packet << response;
+		if (socket.send(packet) != sf::Socket::Done) { break; }
+
+		++tilesRendered;
+	}
+
+	cout << "Worker finished after " << tilesRendered << " tiles" << endl;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "RenderServer.h"
+
+
+// A worker process for distributed rendering. It connects to a
+// TileCoordinator and renders the tiles it is sent until told to stop.
+class TileWorker
+{
+private:
+	sf::TcpSocket socket;
+
+	// Image buffers kept warm between tiles.
+	WarmBuffers warm;
+
+	long long tilesRendered;
+
+public:
+	TileWorker();
+
+	bool Connect(const sf::IpAddress& host, unsigned short port);
+
+	// Render tiles until the coordinator shuts down or disconnects.
+	void Run();
+};
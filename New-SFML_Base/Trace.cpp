@@ -0,0 +1,107 @@
+#include "Trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* name;
+		const char* category;
+		Trace::the_trace_clock::time_point begin, end;
+		int index;
+	};
+
+	// Each thread appends to its own buffer without locking; the
+	// registry only locks when a thread records for the first time.
+	struct ThreadBuffer
+	{
+		int tid;
+		std::string name;
+		std::vector<TraceEvent> events;
+	};
+
+	std::mutex registryLock;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+	Trace::the_trace_clock::time_point epoch;
+
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	ThreadBuffer& LocalBuffer()
+	{
+		if (!localBuffer) {
+			std::lock_guard<std::mutex> lock(registryLock);
+
+			registry.emplace_back(new ThreadBuffer);
+			localBuffer = registry.back().get();
+			localBuffer->tid = (int)registry.size();
+			localBuffer->events.reserve(4096);
+		}
+		return *localBuffer;
+	}
+
+	double Micros(Trace::the_trace_clock::time_point t)
+	{
+		return std::chrono::duration<double, std::micro>(t - epoch).count();
+	}
+}
+
+
+void Trace::Enable()
+{
+	epoch = the_trace_clock::now();
+	enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::NameThread(const std::string& name)
+{
+	if (IsEnabled()) { LocalBuffer().name = name; }
+}
+
+void Trace::Record(const char* name, const char* category,
+	the_trace_clock::time_point begin, the_trace_clock::time_point end, int index)
+{
+	LocalBuffer().events.push_back({ name, category, begin, end, index });
+}
+
+bool Trace::Write(const char* filename)
+{
+	std::ofstream outfile(filename);
+
+	std::lock_guard<std::mutex> lock(registryLock);
+	outfile << "{\"traceEvents\":[" << std::fixed << std::setprecision(3);
+
+	bool first = true;
+	for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+		if (!buffer->name.empty()) {
+			outfile << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+				<< buffer->tid << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+			first = false;
+		}
+
+		// Complete ("X") events carry their own duration.
+		for (const TraceEvent& e : buffer->events) {
+			outfile << (first ? "" : ",") << "\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << Micros(e.begin) << ",\"dur\":" << Micros(e.end) - Micros(e.begin);
+			if (e.index >= 0) { outfile << ",\"args\":{\"index\":" << e.index << "}"; }
+			outfile << "}";
+			first = false;
+		}
+	}
+	outfile << "\n]}\n";
+
+	if (!outfile) {
+		std::cout << "Error writing to " << filename << std::endl;
+		return false;
+	}
+	std::cout << "Trace written to " << filename << std::endl;
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+
+// Records begin/end spans into per-thread buffers while enabled, and
+// writes them as Chrome trace-event JSON for about:tracing or Perfetto.
+// While disabled, a span costs one relaxed load and a branch.
+class Trace
+{
+public:
+	typedef std::chrono::steady_clock the_trace_clock;
+
+	// Start recording; spans opened before this are not kept.
+	static void Enable();
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); };
+
+	// Label the calling thread in the trace viewer.
+	static void NameThread(const std::string& name);
+
+	static void Record(const char* name, const char* category,
+		the_trace_clock::time_point begin, the_trace_clock::time_point end, int index);
+
+	// Write every recorded span. Call once rendering has stopped.
+	static bool Write(const char* filename);
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+
+// Records its own lifetime as a span, if tracing was on when it began.
+// Names and categories must be string literals.
+class TraceSpan
+{
+private:
+	const char* name;
+	const char* category;
+	int index;
+	bool active;
+	Trace::the_trace_clock::time_point begin;
+
+public:
+	TraceSpan(const char* spanName, const char* spanCategory, int spanIndex = -1)
+		: name(spanName), category(spanCategory), index(spanIndex), active(Trace::IsEnabled())
+	{
+		if (active) { begin = Trace::the_trace_clock::now(); }
+	}
+
+	~TraceSpan()
+	{
+		if (active) { Trace::Record(name, category, begin, Trace::the_trace_clock::now(), index); }
+	}
+};
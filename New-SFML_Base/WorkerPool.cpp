@@ -0,0 +1,92 @@
+#include "WorkerPool.h"
+#include "Trace.h"
+
+
+WorkerPool::WorkerPool(const CpuTopology& topology, int threadCount, bool pinned)
+	: generation(0),
+	remaining(0),
+	stopping(false)
+{
+	if (threadCount <= 0) { threadCount = topology.getProcessorCount(); }
+
+	// Deal processors out node by node.
+	std::vector<std::pair<int, int>> placement;
+	for (const CpuTopology::NumaNode& node : topology.getNodes()) {
+		for (int processor : node.processors) {
+			placement.push_back({ processor, node.id });
+		}
+	}
+
+	for (int i = 0; i < threadCount; ++i) {
+		const std::pair<int, int>& slot = placement[i % placement.size()];
+
+		workerNode.push_back(slot.second);
+		threads.emplace_back(&WorkerPool::WorkerLoop, this, i, pinned ? slot.first : -1);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	taskReady.notify_all();
+
+	for (std::thread& t : threads) {
+		t.join();
+	}
+}
+
+void WorkerPool::WorkerLoop(int worker, int processor)
+{
+	// Pin before touching any memory, so first-touch
+	// places this worker's pages on its own node.
+	if (processor >= 0) { CpuTopology::PinCurrentThread(processor); }
+	Trace::NameThread("cpu worker " + std::to_string(worker));
+
+	unsigned seen = 0;
+
+	for (;;) {
+		std::function<void(int)> work;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			taskReady.wait(guard, [&]() { return stopping || generation != seen; });
+
+			if (stopping) { return; }
+
+			seen = generation;
+			work = task;
+		}
+
+		work(worker);
+
+		std::lock_guard<std::mutex> guard(lock);
+		if (--remaining == 0) { taskDone.notify_all(); }
+	}
+}
+
+void WorkerPool::Run(const std::function<void(int)>& work)
+{
+	std::lock_guard<std::mutex> exclusive(runLock);
+
+	std::unique_lock<std::mutex> guard(lock);
+	task = work;
+	remaining = (int)threads.size();
+	++generation;
+	taskReady.notify_all();
+
+	taskDone.wait(guard, [this]() { return remaining == 0; });
+}
+
+const CpuTopology& WorkerPool::SharedTopology()
+{
+	static CpuTopology topology;
+	return topology;
+}
+
+WorkerPool& WorkerPool::Shared()
+{
+	static WorkerPool pool(SharedTopology());
+	return pool;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CpuTopology.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed set of threads, each pinned to one logical processor unless
+// asked otherwise. Workers are numbered node by node, so contiguous
+// ranges of workers share a NUMA node and can own contiguous ranges of a
+// buffer.
+class WorkerPool
+{
+private:
+	std::vector<std::thread> threads;
+
+	// NUMA node of each worker; only a hint when workers are unpinned.
+	std::vector<int> workerNode;
+
+	// The task being run, and how many workers have yet to finish it.
+	std::function<void(int)> task;
+	unsigned generation;
+	int remaining;
+	bool stopping;
+
+	std::mutex lock;
+	std::condition_variable taskReady, taskDone;
+
+	// Only one caller may use the pool at a time.
+	std::mutex runLock;
+
+	void WorkerLoop(int worker, int processor);
+
+public:
+	// A thread count of zero uses every logical processor. Unpinned
+	// workers run wherever the scheduler puts them.
+	WorkerPool(const CpuTopology& topology, int threadCount = 0, bool pinned = true);
+	~WorkerPool();
+
+	int getWorkerCount() const { return (int)threads.size(); };
+	int getNodeOf(int worker) const { return workerNode[worker]; };
+
+	// Run task(worker) once on every worker and wait for all of them.
+	void Run(const std::function<void(int)>& work);
+
+	// The process-wide pool used by the CPU renderer.
+	static WorkerPool& Shared();
+	static const CpuTopology& SharedTopology();
+};
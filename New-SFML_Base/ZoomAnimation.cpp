@@ -0,0 +1,43 @@
+#include "ZoomAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+ZoomAnimation::ZoomAnimation()
+	: pending(0.0),
+	focusX(0.0),
+	focusY(0.0)
+{
+}
+
+void ZoomAnimation::Add(double octaves, double x, double y)
+{
+	pending += octaves;
+	focusX = x;
+	focusY = y;
+}
+
+bool ZoomAnimation::Step(double seconds, int width, int height, double& left, double& right, double& top, double& bottom)
+{
+	if (!Active()) { return false; }
+
+	// Each frame closes the same share of what remains, so a zoom starts
+	// fast and settles, at any frame rate; the tail is taken at once.
+	double octaves = pending * std::min(1.0, seconds / ZOOM_EASE_SECONDS);
+	if (std::abs(pending - octaves) < ZOOM_SETTLE_OCTAVES) { octaves = pending; }
+	pending -= octaves;
+
+	// The focus keeps its point on the complex plane, and the view's
+	// edges close in on it, or move away, by the same factor.
+	const double scale = std::pow(2.0, -octaves);
+	const double x = left + (right - left) * focusX / width;
+	const double y = bottom + (top - bottom) * focusY / height;
+
+	left = x + (left - x) * scale;
+	right = x + (right - x) * scale;
+	bottom = y + (bottom - y) * scale;
+	top = y + (top - y) * scale;
+
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// Zoom factor of one wheel notch.
+const double ZOOM_WHEEL_STEP = 1.5;
+
+// Zoom factor per second while a zoom key is held.
+const double ZOOM_KEY_RATE = 2.0;
+
+// Time constant, in seconds, over which a zoom eases in.
+const double ZOOM_EASE_SECONDS = 0.12;
+
+// Zoom, in octaves, too small to be worth another frame.
+const double ZOOM_SETTLE_OCTAVES = 0.002;
+
+// While zooming, each frame renders this many milliseconds of tiles, this
+// small, so that one slow tile cannot cost a frame. The reprojected last
+// frame shows in between, and a coarse level this far scaled down only
+// fills in where it does not reach.
+const double ZOOM_FRAME_BUDGET_MS = 6.0;
+const int ZOOM_TILE = 16;
+const int ZOOM_COARSE_FACTOR = 32;
+
+// The frame rate animated zoom is meant to hold.
+const double ZOOM_TARGET_FPS = 60.0;
+
+
+// A zoom about a fixed pixel, applied to the view a little each frame
+// rather than all at once, so that it animates smoothly.
+class ZoomAnimation
+{
+private:
+	// Zoom still to apply, in octaves; positive zooms in.
+	double pending;
+
+	// The pixel held still while zooming.
+	double focusX, focusY;
+
+public:
+	ZoomAnimation();
+
+	// Add to the zoom still to apply, now held about pixel (x, y).
+	void Add(double octaves, double x, double y);
+
+	bool Active() const { return pending != 0.0; };
+
+	// Drop any zoom not yet applied, when the view is set some other way.
+	void Stop() { pending = 0.0; };
+
+	// Apply the share of the pending zoom due after seconds have passed
+	// to a width x height pixel view, whose row 0 is at bottom. Returns
+	// whether the view changed.
+	bool Step(double seconds, int width, int height, double& left, double& right, double& top, double& bottom);
+};
@@ -0,0 +1,137 @@
+#include "ZoomBench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+// Import things we need from the standard library
+using std::chrono::duration;
+using std::cout;
+using std::endl;
+
+typedef std::chrono::steady_clock the_zoom_clock;
+
+// Two seconds of animation at the target frame rate.
+const int ZOOM_BENCH_FRAMES = 120;
+
+// Upper edges, in milliseconds, of the histogram's buckets; the last
+// bucket takes everything slower.
+const double ZOOM_BUCKETS[] = { 4.0, 8.0, 12.0, 1000.0 / 60.0, 25.0, 1000.0 / 30.0 };
+
+
+ZoomBench::ZoomBench()
+	: frames(ZOOM_BENCH_FRAMES),
+	imageWidth(WIDTH),
+	imageHeight(HEIGHT),
+	scenes(StandardScenes())
+{
+}
+
+bool ZoomBench::selectScene(const std::string& name)
+{
+	const BenchScene* found = FindScene(name);
+	if (!found) {
+		cout << "Unknown scene " << name << endl;
+		return false;
+	}
+
+	scenes.assign(1, *found);
+	return true;
+}
+
+std::vector<double> ZoomBench::TimeZoom(const BenchScene& scene)
+{
+	Mandelbrot mandel(imageWidth, imageHeight);
+	mandel.setMaxIterations((float)scene.iterations);
+
+	double left = scene.centreX - scene.viewWidth / 2;
+	double right = scene.centreX + scene.viewWidth / 2;
+	double top = scene.centreY + scene.viewWidth * imageHeight / imageWidth / 2;
+	double bottom = scene.centreY - scene.viewWidth * imageHeight / imageWidth / 2;
+
+	// The zoom starts from a finished frame, as it would on screen.
+	mandel.StartProgressive(left, right, top, bottom);
+	mandel.ContinueProgressive(std::numeric_limits<double>::infinity());
+
+	// A zoom key held down at the centre, at exactly the target rate.
+	ZoomAnimation zoom;
+	const double seconds = 1.0 / ZOOM_TARGET_FPS;
+
+	std::vector<double> times;
+	for (int frame = 0; frame < frames; ++frame) {
+		the_zoom_clock::time_point start = the_zoom_clock::now();
+
+		const double previous[4] = { left, right, top, bottom };
+		zoom.Add(std::log2(ZOOM_KEY_RATE) * seconds, imageWidth / 2.0, imageHeight / 2.0);
+		zoom.Step(seconds, imageWidth, imageHeight, left, right, top, bottom);
+
+		// As on screen, the coarse level is only rendered where the last
+		// frame, reprojected, would not cover the view.
+		const bool covered = previous[0] <= left && previous[1] >= right && previous[2] >= top && previous[3] <= bottom;
+		mandel.StartProgressive(left, right, top, bottom, covered ? 0 : ZOOM_COARSE_FACTOR, ZOOM_TILE);
+		mandel.ContinueProgressive(ZOOM_FRAME_BUDGET_MS);
+		mandel.GetMandelPixels();
+
+		duration<double, std::milli> taken = the_zoom_clock::now() - start;
+		times.push_back(taken.count());
+	}
+	return times;
+}
+
+bool ZoomBench::Report(const BenchScene& scene, std::vector<double> times)
+{
+	std::sort(times.begin(), times.end());
+
+	auto percentile = [&](int percent) {
+		return times[std::min(times.size() - 1, (times.size() * percent + 99) / 100 - 1)];
+	};
+
+	const double target = 1000.0 / ZOOM_TARGET_FPS;
+	const size_t within = std::upper_bound(times.begin(), times.end(), target) - times.begin();
+
+	cout << std::left << std::setw(10) << scene.name << std::right << std::fixed << std::setprecision(2)
+		<< " p50 " << std::setw(6) << percentile(50)
+		<< "  p99 " << std::setw(6) << percentile(99)
+		<< "  max " << std::setw(6) << times.back() << " ms, "
+		<< std::setprecision(1) << 100.0 * within / times.size() << "% within " << target << " ms" << endl;
+
+	// One row per bucket, with a bar scaled to the busiest.
+	const int buckets = sizeof(ZOOM_BUCKETS) / sizeof(ZOOM_BUCKETS[0]) + 1;
+	std::vector<size_t> counts(buckets, 0);
+	for (double time : times) {
+		counts[std::upper_bound(ZOOM_BUCKETS, ZOOM_BUCKETS + buckets - 1, time) - ZOOM_BUCKETS]++;
+	}
+	const size_t busiest = *std::max_element(counts.begin(), counts.end());
+
+	for (int b = 0; b < buckets; ++b) {
+		std::ostringstream range;
+		range << std::fixed << std::setprecision(1) << (b > 0 ? ZOOM_BUCKETS[b - 1] : 0.0);
+		if (b < buckets - 1) { range << "-" << ZOOM_BUCKETS[b]; }
+		else { range << "+"; }
+
+		cout << "    " << std::setw(10) << range.str() << " ms " << std::setw(5) << counts[b] << " "
+			<< std::string(40 * counts[b] / busiest, '#') << endl;
+	}
+
+	return percentile(99) <= target;
+}
+
+int ZoomBench::Run()
+{
+	cout << "Zooming " << ZOOM_KEY_RATE << "x per second for " << frames << " frames at "
+		<< imageWidth << "x" << imageHeight << " on " << Mandelbrot::BackendName(Mandelbrot::getDefaultBackend())
+		<< ", " << ZOOM_FRAME_BUDGET_MS << " ms of tiles per frame" << endl;
+	cout << "Times cover rendering and the repack for upload only; the texture upload and the"
+		<< " preview's render-texture draw, on the GPU, are not included" << endl;
+
+	int missed = 0;
+	for (const BenchScene& scene : scenes) {
+		if (!Report(scene, TimeZoom(scene))) { ++missed; }
+	}
+
+	cout << missed << " of " << scenes.size() << " scenes' rendering missed a " << ZOOM_TARGET_FPS << " fps frame at p99" << endl;
+	return missed;
+}
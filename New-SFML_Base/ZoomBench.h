@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Mandelbrot.h"
+#include "SceneSuite.h"
+#include "ZoomAnimation.h"
+
+#include <string>
+#include <vector>
+
+
+// Times the frames of an animated zoom into each standard scene, away
+// from the window, as the interactive application renders them: the
+// zoom's step, a coarse level and a budget of tiles, then the repack
+// for upload. Uploading, and drawing the preview into its render texture
+// and onto the screen, are on the GPU and not included, so a pass here
+// bounds only the CPU side of a frame.
+class ZoomBench
+{
+private:
+	int frames;
+	int imageWidth, imageHeight;
+
+	std::vector<BenchScene> scenes;
+
+	// Milliseconds taken by each frame of a zoom into one scene.
+	std::vector<double> TimeZoom(const BenchScene& scene);
+
+	// Print percentiles and a histogram of the frame times.
+	static bool Report(const BenchScene& scene, std::vector<double> times);
+
+public:
+	ZoomBench();
+
+	void setFrames(int count) { frames = count; };
+	void setResolution(int width, int height) { imageWidth = width; imageHeight = height; };
+
+	// Restrict the run to a single standard scene.
+	bool selectScene(const std::string& name);
+
+	// Zoom into every scene, and return how many missed ZOOM_TARGET_FPS
+	// at the 99th percentile.
+	int Run();
+};
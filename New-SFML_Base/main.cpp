@@ -2,7 +2,7 @@
 //	^- 'windowProcess()' organisation and Input Framework.
 
 // [2] Falconer, R 2021, Week 9 CPP file for CMP202 (https://mylearningspace.abertay.ac.uk/d2l/le/content/17327/viewContent/344998/View). IEEE, 'reductionBB.cpp'.
-//	^- 'AMPQuery' functions to query AMP for available accelerators.
+//	^- Capabilities accelerator report, adapted from the 'AMPQuery' functions to query AMP for available accelerators.
 
 // [3] Sampson, A 2020, Mandelbrot set example for CMP202 lab (https://mylearningspace.abertay.ac.uk/d2l/le/content/17327/viewContent/227552/View). IEEE, 'mandelbrot.zip'.
 //	^- Mandelbrot::ComputeMandelbrot and WriteTga adapted from the first week's Mandelbrot practical.
@@ -12,6 +12,21 @@
 
 
 #include "InteractMandel.h"
+#include "AutoTuner.h"
+#include "BatchRender.h"
+#include "Buddhabrot.h"
+#include "Benchmark.h"
+#include "Capabilities.h"
+#include "GoldenImage.h"
+#include "RenderClient.h"
+#include "RenderServer.h"
+#include "TileCoordinator.h"
+#include "TileWorker.h"
+#include "Trace.h"
+#include "ZoomBench.h"
+
+#include <algorithm>
+#include <cstring>
 
 void windowProcess(sf::RenderWindow* window, Input* input) { // [1]
 	// Handle window events.
@@ -69,7 +84,326 @@ void windowProcess(sf::RenderWindow* window, Input* input) { // [1]
 	}
 }
 
-int main() {
+int RunBatch(int argc, char* argv[]) {
+	// Usage: --batch <job list> [--jobs <concurrent jobs>] [--stats] [--aa <grid>]
+	BatchRender batch;
+
+	for (int i = 3; i < argc; ++i) {
+		if (i + 1 < argc && std::strcmp(argv[i], "--jobs") == 0) {
+			batch.setLanes(std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--stats") == 0) {
+			batch.setCollectStats(true);
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--aa") == 0) {
+			const int grid = std::atoi(argv[++i]);
+			if (grid < 2 || grid > MAX_AA_GRID) {
+				std::cout << "--aa takes a grid of 2 to " << MAX_AA_GRID << std::endl;
+				return 1;
+			}
+			batch.setAntialias(grid);
+		}
+	}
+
+	if (!batch.LoadJobs(argv[2])) { return 1; }
+
+	return batch.Run() == 0 ? 0 : 1;
+}
+
+int RunServer(int argc, char* argv[]) {
+	// Usage: --serve [port] [workers], answering local clients only
+	unsigned short port = argc > 2 ? (unsigned short)std::atoi(argv[2]) : RENDER_PORT;
+	int workers = argc > 3 ? std::atoi(argv[3]) : 0;
+
+	RenderServer server(workers);
+	if (!server.Listen(port)) { return 1; }
+
+	server.Run();
+	return 0;
+}
+
+int RunClient(int argc, char* argv[]) {
+	// Usage: --client <host> <port> <job list> [--shutdown]
+	// Outputs ending in .tga are requested as images, anything
+	// else as raw little-endian iteration counts.
+	BatchRender jobList;
+	if (!jobList.LoadJobs(argv[4])) { return 1; }
+
+	RenderClient client;
+	if (!client.Connect(argv[2], (unsigned short)std::atoi(argv[3]))) { return 1; }
+
+	// Send every request up front so the server can batch them.
+	const std::vector<BatchJob>& jobs = jobList.getJobs();
+	for (sf::Uint32 i = 0; i < jobs.size(); ++i) {
+		const std::string& output = jobs[i].output;
+		bool tga = output.size() > 4 && output.compare(output.size() - 4, 4, ".tga") == 0;
+
+		RenderRequest request;
+		request.id = i;
+		request.format = tga ? PayloadFormat::TGA : PayloadFormat::ITERATIONS;
+		request.centreX = jobs[i].centreX;
+		request.centreY = jobs[i].centreY;
+		request.viewWidth = jobs[i].viewWidth;
+		request.iterations = jobs[i].iterations;
+		request.imageWidth = jobs[i].imageWidth;
+		request.imageHeight = jobs[i].imageHeight;
+
+		if (!client.Send(request)) {
+			std::cout << "Lost connection while sending requests." << std::endl;
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	for (size_t received = 0; received < jobs.size(); ++received) {
+		RenderResponse response;
+		if (!client.Receive(response) || response.id >= jobs.size()) {
+			std::cout << "Lost connection while receiving responses." << std::endl;
+			return 1;
+		}
+
+		const BatchJob& job = jobs[response.id];
+		bool ok = response.ok;
+
+		if (ok) {
+			std::ofstream outfile(job.output, std::ofstream::binary);
+			outfile.write(response.payload.data(), response.payload.size());
+			ok = outfile.good();
+		}
+		if (!ok) { ++failures; }
+
+		std::cout << (ok ? "Received " : "FAILED ") << job.output
+			<< (response.cached ? " (cached)" : "")
+			<< ": queued " << response.queueMicros << " us, served " << response.serviceMicros << " us" << std::endl;
+	}
+
+	if (argc > 5 && std::strcmp(argv[5], "--shutdown") == 0) { client.Shutdown(); }
+
+	return failures == 0 ? 0 : 1;
+}
+
+int RunCoordinator(int argc, char* argv[]) {
+	// Usage: --coordinate <port> <job list> [tile size]
+	BatchRender jobList;
+	if (!jobList.LoadJobs(argv[3])) { return 1; }
+
+	TileCoordinator coordinator(argc > 4 ? std::atoi(argv[4]) : DEFAULT_TILE_SIZE);
+	if (!coordinator.Listen((unsigned short)std::atoi(argv[2]))) { return 1; }
+
+	int failures = 0;
+	for (BatchJob job : jobList.getJobs()) {
+		Mandelbrot mandel(job.imageWidth, job.imageHeight);
+
+		// Tiles left to choose their own limits would not match, so the
+		// whole frame's limit is chosen here.
+		if (job.iterations == AUTO_ITERATIONS) {
+			job.iterations = mandel.ChooseIterationsView(job.centreX, job.centreY, job.viewWidth).limit;
+			std::cout << job.output << ": " << job.iterations << " iterations (auto)" << std::endl;
+		}
+
+		if (!coordinator.Render(job, mandel) || !mandel.WriteTga(job.output.c_str())) { ++failures; }
+	}
+	coordinator.Shutdown();
+
+	return failures == 0 ? 0 : 1;
+}
+
+int RunWorker(int argc, char* argv[]) {
+	// Usage: --worker <host> <port>
+	TileWorker worker;
+	if (!worker.Connect(argv[2], (unsigned short)std::atoi(argv[3]))) { return 1; }
+
+	worker.Run();
+	return 0;
+}
+
+int RunBenchmark(int argc, char* argv[]) {
+	// Usage: --bench [--warmup N] [--reps N] [--size W H] [--backend amp|cpu|all]
+	//                [--scene name] [--precisions p,p,...|all] [--format csv|json] [--out file]
+	//                [--baseline file] [--threshold percent] [--write-baseline file]
+	// Exits with 2 if any result regressed against the baseline.
+	Benchmark bench;
+	std::string format = "csv";
+	const char* outPath = nullptr;
+	const char* baselinePath = nullptr;
+	const char* writeBaselinePath = nullptr;
+	double threshold = DEFAULT_REGRESSION_THRESHOLD;
+
+	for (int i = 2; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+
+		if (hasValue && std::strcmp(argv[i], "--warmup") == 0) {
+			bench.setWarmup(std::atoi(argv[++i]));
+		}
+		else if (hasValue && std::strcmp(argv[i], "--reps") == 0) {
+			bench.setRepetitions(std::max(1, std::atoi(argv[++i])));
+		}
+		else if (i + 2 < argc && std::strcmp(argv[i], "--size") == 0) {
+			int w = std::atoi(argv[++i]);
+			int h = std::atoi(argv[++i]);
+			bench.setResolution(std::max(1, w), std::max(1, h));
+		}
+		else if (hasValue && std::strcmp(argv[i], "--backend") == 0) {
+			std::string use = argv[++i];
+			if (use == "amp") { bench.setBackends({ Backend::AMP }); }
+			else if (use == "cpu") { bench.setBackends({ Backend::CPU }); }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--scene") == 0) {
+			if (!bench.selectScene(argv[++i])) { return 1; }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--precisions") == 0) {
+			if (!bench.selectPrecisions(argv[++i])) { return 1; }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--baseline") == 0) {
+			baselinePath = argv[++i];
+		}
+		else if (hasValue && std::strcmp(argv[i], "--threshold") == 0) {
+			threshold = std::atof(argv[++i]);
+		}
+		else if (hasValue && std::strcmp(argv[i], "--write-baseline") == 0) {
+			writeBaselinePath = argv[++i];
+		}
+		else if (hasValue && std::strcmp(argv[i], "--format") == 0) {
+			format = argv[++i];
+		}
+		else if (hasValue && std::strcmp(argv[i], "--out") == 0) {
+			outPath = argv[++i];
+		}
+		else {
+			std::cout << "Unknown benchmark option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (baselinePath && !bench.LoadBaseline(baselinePath)) { return 1; }
+
+	bench.Run();
+
+	// Results go to a file if given, otherwise after the progress lines.
+	std::ofstream outfile;
+	if (outPath) {
+		outfile.open(outPath);
+		if (!outfile) {
+			std::cout << "Unable to write " << outPath << std::endl;
+			return 1;
+		}
+	}
+	std::ostream& out = outPath ? outfile : std::cout;
+
+	if (format == "json") { bench.WriteJson(out); }
+	else { bench.WriteCsv(out); }
+
+	if (writeBaselinePath && !bench.WriteBaseline(writeBaselinePath)) { return 1; }
+
+	if (baselinePath && bench.CompareBaseline(threshold) > 0) { return 2; }
+
+	return 0;
+}
+
+int RunGolden(int argc, char* argv[]) {
+	// Usage: --golden [--dir path] [--backend amp|cpu|all] [--scene name]
+	//                 [--diff dir] [--update]
+	// Exits with 1 if any backend drifted beyond its scene's tolerance.
+	std::string directory = DEFAULT_GOLDEN_DIR;
+	std::string scene;
+	std::string diffDirectory;
+	std::vector<Backend> backends = { Backend::AMP, Backend::CPU };
+	bool update = false;
+
+	for (int i = 2; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+
+		if (hasValue && std::strcmp(argv[i], "--dir") == 0) {
+			directory = argv[++i];
+		}
+		else if (hasValue && std::strcmp(argv[i], "--backend") == 0) {
+			std::string use = argv[++i];
+			if (use == "amp") { backends = { Backend::AMP }; }
+			else if (use == "cpu") { backends = { Backend::CPU }; }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--scene") == 0) {
+			scene = argv[++i];
+		}
+		else if (hasValue && std::strcmp(argv[i], "--diff") == 0) {
+			diffDirectory = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--update") == 0) {
+			update = true;
+		}
+		else {
+			std::cout << "Unknown golden option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	GoldenSuite suite(directory);
+	suite.setBackends(backends);
+	suite.setDiffDirectory(diffDirectory);
+	if (!scene.empty() && !suite.selectScene(scene)) { return 1; }
+
+	// Goldens come from the reference alone, never from a backend.
+	if (update) { return suite.Update() ? 0 : 1; }
+
+	return suite.Check() == 0 ? 0 : 1;
+}
+
+int RunTune(int argc, char* argv[]) {
+	// Usage: --tune [--scene name] [--out file]
+	// Saves to this machine's tuning file unless told otherwise.
+	AutoTuner tuner;
+	std::string outPath = AutoTuner::DefaultPath();
+
+	for (int i = 2; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+
+		if (hasValue && std::strcmp(argv[i], "--scene") == 0) {
+			if (!tuner.selectScene(argv[++i])) { return 1; }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--out") == 0) {
+			outPath = argv[++i];
+		}
+		else {
+			std::cout << "Unknown tuning option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	TuneConfig best = tuner.Run();
+	if (!AutoTuner::Save(outPath, best)) { return 1; }
+
+	std::cout << "Saved tuning to " << outPath << std::endl;
+	return 0;
+}
+
+int RunZoomBench(int argc, char* argv[]) {
+	// Usage: --zoom-bench [--scene name] [--frames N] [--size W H]
+	// Fails if any scene's 99th percentile frame, rendering only, misses the target rate.
+	ZoomBench bench;
+
+	for (int i = 2; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+
+		if (hasValue && std::strcmp(argv[i], "--scene") == 0) {
+			if (!bench.selectScene(argv[++i])) { return 1; }
+		}
+		else if (hasValue && std::strcmp(argv[i], "--frames") == 0) {
+			bench.setFrames(std::max(1, std::atoi(argv[++i])));
+		}
+		else if (i + 2 < argc && std::strcmp(argv[i], "--size") == 0) {
+			int w = std::atoi(argv[++i]);
+			int h = std::atoi(argv[++i]);
+			bench.setResolution(std::max(1, w), std::max(1, h));
+		}
+		else {
+			std::cout << "Unknown zoom benchmark option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	return bench.Run() == 0 ? 0 : 1;
+}
+
+int RunInteractive() {
 	//Create the window
 	sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "MandelApp");
 
@@ -83,9 +417,9 @@ int main() {
 	// Create an interface for Mandelbrot interaction.
 	InteractMandel mandelMain(&window, &input);
 
-	// Write accelerator report to console.
-	AMPQuery accelQuery;
-	accelQuery.QueryAMPSupport();
+	// Write capability report to console.
+	Capabilities::Get().Report();
+	std::cout << " rendering with   = " << Mandelbrot::BackendName(Mandelbrot::getDefaultBackend()) << std::endl;
 
 	while (window.isOpen()) {
 		//Process window events
@@ -106,4 +440,189 @@ int main() {
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
+
+int RunBuddhabrot(int argc, char* argv[]) {
+	// Usage: --buddha [--size W H] [--view x y width] [--samples N]
+	//                 [--tolerance change] [--nebula] [--out file]
+	int width = WIDTH, height = HEIGHT;
+	double x = -0.5, y = 0.0, viewWidth = 3.0;
+	long long samples = 16 * BUDDHA_ROUND_SAMPLES;
+	double tolerance = BUDDHA_DEFAULT_TOLERANCE;
+	bool nebula = false;
+	std::string outPath = "buddhabrot.tga";
+
+	for (int i = 2; i < argc; ++i) {
+		bool hasValue = i + 1 < argc;
+
+		if (i + 2 < argc && std::strcmp(argv[i], "--size") == 0) {
+			width = std::max(1, std::atoi(argv[++i]));
+			height = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (i + 3 < argc && std::strcmp(argv[i], "--view") == 0) {
+			x = std::atof(argv[++i]);
+			y = std::atof(argv[++i]);
+			viewWidth = std::atof(argv[++i]);
+		}
+		else if (hasValue && std::strcmp(argv[i], "--samples") == 0) {
+			samples = std::max(1LL, std::atoll(argv[++i]));
+		}
+		else if (hasValue && std::strcmp(argv[i], "--tolerance") == 0) {
+			tolerance = std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--nebula") == 0) {
+			nebula = true;
+		}
+		else if (hasValue && std::strcmp(argv[i], "--out") == 0) {
+			outPath = argv[++i];
+		}
+		else {
+			std::cout << "Unknown Buddhabrot option " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	Buddhabrot buddha(width, height);
+	buddha.setView(x, y, viewWidth);
+	buddha.setFormula(Mandelbrot::getDefaultFormula());
+	buddha.setNebula(nebula);
+	buddha.setMaxSamples(samples);
+	buddha.setTolerance(tolerance);
+
+	buddha.Run();
+
+	return buddha.WriteTga(outPath.c_str()) ? 0 : 1;
+}
+
+// Set by --cpu or --amp, which skip automatic backend selection.
+bool backendForced = false;
+
+// Render with the fastest backend the capability registry found. Only
+// for modes which use the default backend; the benchmark and golden
+// check choose their own, and must open counters before the pool starts.
+void ChooseDefaultBackend() {
+	if (!backendForced) {
+		Mandelbrot::setDefaultBackend(Capabilities::Get().getChosen());
+	}
+}
+
+int RunMode(int argc, char* argv[]) {
+	if (argc > 1 && std::strcmp(argv[1], "--caps") == 0) {
+		Capabilities::Get().Report();
+		return 0;
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--tune") == 0) {
+		return RunTune(argc, argv);
+	}
+
+	// Headless modes render without ever creating a window.
+	if (argc > 2 && std::strcmp(argv[1], "--batch") == 0) {
+		ChooseDefaultBackend();
+		return RunBatch(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+		return RunBenchmark(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--golden") == 0) {
+		return RunGolden(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--zoom-bench") == 0) {
+		ChooseDefaultBackend();
+		return RunZoomBench(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--buddha") == 0) {
+		ChooseDefaultBackend();
+		return RunBuddhabrot(argc, argv);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "--serve") == 0) {
+		ChooseDefaultBackend();
+		return RunServer(argc, argv);
+	}
+	// The client renders nothing itself, so has no backend to choose.
+	if (argc > 4 && std::strcmp(argv[1], "--client") == 0) {
+		return RunClient(argc, argv);
+	}
+	// The coordinator renders the probes which choose automatic limits.
+	if (argc > 3 && std::strcmp(argv[1], "--coordinate") == 0) {
+		ChooseDefaultBackend();
+		return RunCoordinator(argc, argv);
+	}
+	if (argc > 3 && std::strcmp(argv[1], "--worker") == 0) {
+		ChooseDefaultBackend();
+		return RunWorker(argc, argv);
+	}
+
+	ChooseDefaultBackend();
+	return RunInteractive();
+}
+
+int main(int argc, char* argv[]) {
+	// Options which may appear anywhere and apply to every mode:
+	//   --cpu           render with the CPU backend
+	//   --amp           render with the AMP backend
+	//                   without either, the fastest backend found at startup is used
+	//   --precision <p> iterate in float, double, dd (double-double), fixed64 or fixed128
+	//   --formula <f>   iterate mandelbrot, julia, multibrot3, multibrot4 or burningship
+	//   --julia <x> <y> the constant of the julia formula
+	//   --distance      shade by estimated distance from the set
+	//   --trace <file>  write Chrome trace-event JSON on exit
+	const char* tracePath = nullptr;
+
+	int kept = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--cpu") == 0) {
+			Mandelbrot::setDefaultBackend(Backend::CPU);
+			backendForced = true;
+		}
+		else if (std::strcmp(argv[i], "--amp") == 0) {
+			Mandelbrot::setDefaultBackend(Backend::AMP);
+			backendForced = true;
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--precision") == 0) {
+			Precision precision;
+			if (Mandelbrot::ParsePrecision(argv[++i], precision)) { Mandelbrot::setDefaultPrecision(precision); }
+			else {
+				std::cout << "Unknown precision " << argv[i] << "; using float" << std::endl;
+				Mandelbrot::setDefaultPrecision(Precision::FLOAT);
+			}
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--formula") == 0) {
+			Formula formula;
+			if (Mandelbrot::ParseFormula(argv[++i], formula)) { Mandelbrot::setDefaultFormula(formula); }
+			else { std::cout << "Unknown formula " << argv[i] << "; using mandelbrot" << std::endl; }
+		}
+		else if (std::strcmp(argv[i], "--distance") == 0) {
+			Mandelbrot::setDefaultDistanceEstimation(true);
+		}
+		else if (i + 2 < argc && std::strcmp(argv[i], "--julia") == 0) {
+			double x = std::atof(argv[++i]);
+			double y = std::atof(argv[++i]);
+			Mandelbrot::setDefaultJulia(x, y);
+		}
+		else if (i + 1 < argc && std::strcmp(argv[i], "--trace") == 0) {
+			tracePath = argv[++i];
+		}
+		else {
+			argv[kept++] = argv[i];
+		}
+	}
+	argc = kept;
+
+	if (tracePath) {
+		Trace::Enable();
+		Trace::NameThread("main");
+	}
+
+	// Start from this machine's tuned settings, if it has been tuned.
+	TuneConfig tuning;
+	if (AutoTuner::Load(AutoTuner::DefaultPath(), tuning)) {
+		Mandelbrot::setTuning(tuning);
+		std::cout << "Loaded tuning from " << AutoTuner::DefaultPath() << std::endl;
+	}
+
+	int status = RunMode(argc, argv);
+
+	if (tracePath) { Trace::Write(tracePath); }
+
+	return status;
+}